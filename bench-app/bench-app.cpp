@@ -0,0 +1,360 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sbflib.h>
+#include <ingest.h>
+#include <evaluate.h>
+
+#include "perf-counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+
+
+//This program builds a SBF over a test dataset and measures its performance
+//without any user interaction: the settings are given as command line flags,
+//and the results (build and check throughput, check latency percentiles,
+//memory footprint and the filter statistics) are printed as JSON, so that
+//runs can be scripted and compared across library versions.
+//With --perf, hardware performance counters are sampled around the build,
+//check and verify phases and reported per element (null if not available).
+
+
+typedef std::chrono::steady_clock Clock;
+
+
+//benchmark settings, as read from the command line
+struct Settings {
+	std::string dataset;
+	std::string verification;
+	std::string salt;
+	std::string mode;
+	std::string output;
+	char delimiter;
+	int hash_family;
+	int hash_number;
+	int bit_mapping;
+	double fpp;
+	int threads;
+	int latency_samples;
+	bool perf;
+};
+
+
+void Usage() {
+	std::cerr << "Usage: bench-app --dataset FILE [options]" << std::endl;
+	std::cerr << "  --dataset FILE          construction dataset (area,element per line; - for stdin)" << std::endl;
+	std::cerr << "  --verification FILE     non-elements dataset (required by verify and all modes)" << std::endl;
+	std::cerr << "  --mode MODE             build, check, verify or all (default: all)" << std::endl;
+	std::cerr << "  --hash-family N         1 (SHA1), 4 (MD4), 5 (MD5) (default: 4)" << std::endl;
+	std::cerr << "  --hash-number N         number of hash runs (default: derived from --fpp)" << std::endl;
+	std::cerr << "  --bit-mapping N         filter size exponent (default: derived from --fpp)" << std::endl;
+	std::cerr << "  --fpp P                 target false positives probability (default: 0.001)" << std::endl;
+	std::cerr << "  --threads N             worker threads, 0 for all hardware threads (default: 0)" << std::endl;
+	std::cerr << "  --salt FILE             hash salt file, created if missing (default: SBFHashSalt.txt)" << std::endl;
+	std::cerr << "  --delimiter C           dataset delimiter (default: ,)" << std::endl;
+	std::cerr << "  --latency-samples N     checks timed one by one for latency (default: 100000)" << std::endl;
+	std::cerr << "  --output FILE           JSON output file (default: standard output)" << std::endl;
+	std::cerr << "  --perf                  samples hardware performance counters" << std::endl;
+}
+
+
+//parses the command line flags; returns false on invalid input
+bool ParseArguments(int argc, char** argv, Settings& s) {
+	s.mode = "all";
+	s.salt = "SBFHashSalt.txt";
+	s.delimiter = ',';
+	s.hash_family = 4;
+	s.hash_number = 0;
+	s.bit_mapping = 0;
+	s.fpp = 0.001;
+	s.threads = 0;
+	s.latency_samples = 100000;
+	s.perf = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string flag(argv[i]);
+		if (flag == "--perf") {
+			s.perf = true;
+			continue;
+		}
+		if (i + 1 >= argc) return false;
+		std::string value(argv[++i]);
+
+		if (flag == "--dataset") s.dataset = value;
+		else if (flag == "--verification") s.verification = value;
+		else if (flag == "--mode") s.mode = value;
+		else if (flag == "--hash-family") s.hash_family = atoi(value.c_str());
+		else if (flag == "--hash-number") s.hash_number = atoi(value.c_str());
+		else if (flag == "--bit-mapping") s.bit_mapping = atoi(value.c_str());
+		else if (flag == "--fpp") s.fpp = atof(value.c_str());
+		else if (flag == "--threads") s.threads = atoi(value.c_str());
+		else if (flag == "--salt") s.salt = value;
+		else if (flag == "--delimiter") s.delimiter = value.empty() ? ',' : value[0];
+		else if (flag == "--latency-samples") s.latency_samples = atoi(value.c_str());
+		else if (flag == "--output") s.output = value;
+		else return false;
+	}
+
+	if (s.dataset.empty()) return false;
+	if (s.mode != "build" && s.mode != "check" && s.mode != "verify" && s.mode != "all") return false;
+	if ((s.mode == "verify" || s.mode == "all") && s.verification.empty()) return false;
+	if (s.mode != "build" && s.mode != "verify" && s.dataset == "-") return false;
+	return true;
+}
+
+
+double Seconds(const Clock::time_point& start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+//returns the peak resident set size of the process in bytes (0 if unknown)
+long long PeakRss() {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (getline(status, line)) {
+		if (line.compare(0, 6, "VmHWM:") == 0) return atoll(line.c_str() + 6) * 1024;
+	}
+	return 0;
+}
+
+
+//JSON value helpers
+std::string JsonString(const std::string& value) {
+	std::string out("\"");
+	for (size_t i = 0; i < value.size(); i++) {
+		char c = value[i];
+		if (c == '"' || c == '\\') out += '\\';
+		if ((unsigned char)c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+		}
+		else out += c;
+	}
+	return out + "\"";
+}
+
+std::string JsonNumber(double value) {
+	if (!std::isfinite(value)) return "null";
+	std::ostringstream out;
+	out.precision(9);
+	out << value;
+	return out.str();
+}
+
+
+//writes the counter values of the last region, per element, as a JSON object
+std::string PerfJson(const PerfCounters& perf, long long elements) {
+	if (!perf.Enabled()) return "null";
+	std::ostringstream out;
+	out << "{";
+	for (int c = 0; c < PerfCounters::COUNT; c++) {
+		double value = perf.Value(c);
+		out << (c > 0 ? ", " : "") << "\"" << PerfCounters::Name(c) << "_per_element\": " << (value < 0 ? "null" : JsonNumber(value / elements));
+	}
+	out << "}";
+	return out.str();
+}
+
+
+//reads up to limit elements from a dataset (the part following the delimiter
+//for labelled datasets, the whole line otherwise)
+void LoadSample(const std::string& path, bool labelled, char delimiter, int limit, std::vector<std::string>& sample) {
+	std::ifstream myfile(path.c_str());
+	std::string line;
+	while ((int)sample.size() < limit && getline(myfile, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		if (labelled) line = line.substr(line.find(delimiter) + 1);
+		sample.push_back(line);
+	}
+}
+
+
+//times each Check of the sample and writes the latency percentiles (in
+//nanoseconds) as a JSON object
+std::string Latency(const sbf::SBF* filter, const std::vector<std::string>& sample) {
+	std::vector<double> ns;
+	ns.reserve(sample.size());
+	volatile int sink = 0;
+
+	for (size_t i = 0; i < sample.size(); i++) {
+		Clock::time_point start = Clock::now();
+		sink += filter->Check(sample[i].data(), (int)sample[i].size());
+		ns.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+	}
+	(void)sink;
+
+	std::ostringstream out;
+	out << "{\"samples\": " << ns.size();
+	if (!ns.empty()) {
+		std::sort(ns.begin(), ns.end());
+		double sum = 0;
+		for (size_t i = 0; i < ns.size(); i++) sum += ns[i];
+		out << ", \"mean\": " << JsonNumber(sum / ns.size());
+		out << ", \"p50\": " << JsonNumber(ns[ns.size() / 2]);
+		out << ", \"p99\": " << JsonNumber(ns[std::min(ns.size() - 1, ns.size() * 99 / 100)]);
+		out << ", \"max\": " << JsonNumber(ns.back());
+	}
+	out << "}";
+	return out.str();
+}
+
+
+int main(int argc, char** argv) {
+
+	Settings s;
+	if (!ParseArguments(argc, argv, s)) {
+		Usage();
+		return 1;
+	}
+
+	std::ostringstream json;
+	json << "{" << std::endl;
+	json << "  \"settings\": {\"dataset\": " << JsonString(s.dataset) << ", \"verification\": " << JsonString(s.verification)
+		<< ", \"mode\": " << JsonString(s.mode) << ", \"hash_family\": " << s.hash_family << ", \"hash_number\": " << s.hash_number
+		<< ", \"bit_mapping\": " << s.bit_mapping << ", \"fpp\": " << JsonNumber(s.fpp) << ", \"threads\": " << s.threads << "}," << std::endl;
+
+	/* ******************************* BUILD ******************************* */
+
+	sbf::IngestOptions options;
+	options.HASH_family = s.hash_family;
+	options.HASH_number = s.hash_number;
+	options.bit_mapping = s.bit_mapping;
+	options.max_fpp = s.fpp;
+	options.salt_path = s.salt;
+	options.delimiter = s.delimiter;
+	options.threads = s.threads;
+
+	PerfCounters perf(s.perf);
+	if (s.perf && !perf.Enabled()) std::cerr << "Hardware performance counters are not available" << std::endl;
+
+	sbf::SBF* myFilter = NULL;
+	Clock::time_point start;
+	double seconds;
+
+	try {
+		sbf::Ingest ingest(options);
+		perf.Start();
+		start = Clock::now();
+		myFilter = ingest.Run(s.dataset);
+		seconds = Seconds(start);
+		perf.Stop();
+
+		json << "  \"build\": {\"elements\": " << ingest.GetMembers() << ", \"bytes\": " << ingest.GetBytes()
+			<< ", \"seconds\": " << JsonNumber(seconds) << ", \"elements_per_second\": " << JsonNumber(ingest.GetMembers() / seconds)
+			<< ", \"rebuilds\": " << ingest.GetRebuilds() << ", \"perf\": " << PerfJson(perf, ingest.GetMembers()) << "}," << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	myFilter->SetAPrioriAreaFpp();
+	myFilter->SetAreaFpp();
+	myFilter->SetAPrioriAreaIsep();
+	myFilter->SetAreaIsep();
+	myFilter->SetExpectedAreaCells();
+
+	/* ******************************* CHECK ******************************* */
+
+	sbf::Evaluator evaluator(myFilter, s.threads, s.delimiter);
+
+	try {
+		if (s.mode == "check" || s.mode == "all") {
+			perf.Start();
+			start = Clock::now();
+			evaluator.SelfCheck(s.dataset);
+			seconds = Seconds(start);
+			perf.Stop();
+
+			std::vector<std::string> sample;
+			LoadSample(s.dataset, true, s.delimiter, s.latency_samples, sample);
+
+			const sbf::EvaluationReport& report = evaluator.GetReport();
+			long long elements = report.members;
+			json << "  \"check\": {\"elements\": " << report.members << ", \"seconds\": " << JsonNumber(seconds)
+				<< ", \"elements_per_second\": " << JsonNumber(report.members / seconds) << ", \"inter_set_errors\": " << report.iser
+				<< ", \"inter_set_error_rate\": " << JsonNumber(report.GetIserRate()) << ", \"latency_ns\": " << Latency(myFilter, sample) << ", \"perf\": " << PerfJson(perf, elements) << "}," << std::endl;
+		}
+
+		if (s.mode == "verify" || s.mode == "all") {
+			perf.Start();
+			start = Clock::now();
+			evaluator.Verify(s.verification);
+			seconds = Seconds(start);
+			perf.Stop();
+
+			std::vector<std::string> sample;
+			LoadSample(s.verification, false, s.delimiter, s.latency_samples, sample);
+
+			const sbf::EvaluationReport& report = evaluator.GetReport();
+			long long elements = report.non_members;
+			json << "  \"verify\": {\"elements\": " << report.non_members << ", \"seconds\": " << JsonNumber(seconds)
+				<< ", \"elements_per_second\": " << JsonNumber(report.non_members / seconds) << ", \"false_positives\": " << report.false_positives
+				<< ", \"false_positive_rate\": " << JsonNumber(report.GetFpRate()) << ", \"latency_ns\": " << Latency(myFilter, sample) << ", \"perf\": " << PerfJson(perf, elements) << "}," << std::endl;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	/* ****************************** MEMORY ****************************** */
+
+	sbf::MemoryUsage usage = myFilter->GetMemoryUsage();
+	json << "  \"memory\": {\"total_bytes\": " << usage.GetTotal() << ", \"resident_bytes\": " << usage.GetResident()
+		<< ", \"cells_bytes\": " << usage.cells << ", \"cells_mapped_bytes\": " << usage.cells_mapped << ", \"cells_resident_bytes\": " << usage.cells_resident
+		<< ", \"salts_bytes\": " << usage.salts << ", \"areas_bytes\": " << usage.areas << ", \"peak_rss_bytes\": " << PeakRss() << "}," << std::endl;
+
+	/* ****************************** FILTER ****************************** */
+
+	json << "  \"filter\": {\"bit_mapping\": " << myFilter->GetBitMapping() << ", \"cells\": " << (1LL << myFilter->GetBitMapping())
+		<< ", \"hash_family\": " << myFilter->GetHashFamily() << ", \"hash_number\": " << myFilter->GetHashNumber()
+		<< ", \"area_number\": " << myFilter->GetAreaNumber() << ", \"members\": " << myFilter->GetMembers()
+		<< ", \"sparsity\": " << JsonNumber(myFilter->GetFilterSparsity()) << ", \"a_priori_fpp\": " << JsonNumber(myFilter->GetFilterAPrioriFpp())
+		<< ", \"fpp\": " << JsonNumber(myFilter->GetFilterFpp()) << "," << std::endl;
+	json << "    \"areas\": [";
+	for (int j = 1; j < myFilter->GetAreaNumber() + 1; j++) {
+		json << (j > 1 ? "," : "") << std::endl << "      {\"area\": " << j << ", \"members\": " << myFilter->GetAreaMembers(j)
+			<< ", \"expected_emersion\": " << JsonNumber(myFilter->GetExpectedAreaEmersion(j)) << ", \"emersion\": " << JsonNumber(myFilter->GetAreaEmersion(j)) << "}";
+	}
+	json << std::endl << "    ]}" << std::endl << "}" << std::endl;
+
+	if (s.output.empty()) std::cout << json.str();
+	else {
+		std::ofstream output(s.output.c_str());
+		output << json.str();
+	}
+
+	delete myFilter;
+	return 0;
+}
@@ -0,0 +1,293 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sbflib.h>
+
+#include "perf-counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+
+//This program measures the cost of the single SBF operations (Insert, Check
+//on members and non-members, the Set*/Get* statistics, SaveToDisk and the
+//hash salt creation and loading) over a sweep of hash families, numbers of
+//hashes, cell sizes (1 byte up to 255 areas, 2 bytes otherwise) and filter
+//sizes, from L1-resident filters up to DRAM-sized ones.
+//With --perf, hardware performance counters (cycles, instructions, L1/LLC
+//and dTLB misses, branch mispredictions) are sampled around each benchmark
+//and reported per operation, which helps attributing the cost of Check to
+//hashing (see the Digest benchmark) or to cell accesses (see CheckDigests).
+//Counters which are not available are reported as NA.
+//Results are printed one per line as CSV records (semicolon separated, like
+//the files written by SaveToDisk) with a fixed set of columns and a stable
+//order, so that runs of different library versions can be diffed line by
+//line.
+
+
+typedef std::chrono::steady_clock Clock;
+
+
+//benchmark settings, as read from the command line
+struct Settings {
+	std::vector<int> families;
+	std::vector<int> hash_numbers;
+	std::vector<int> areas;
+	std::vector<int> bit_mappings;
+	long long max_elements;
+	double min_time;
+	std::string salt_prefix;
+	bool perf;
+};
+
+
+//the outcome of a benchmark: operations, time and counters per operation
+struct Result {
+	long long ops;
+	double ns;
+	double counters[PerfCounters::COUNT];
+};
+
+
+void Usage() {
+	std::cerr << "Usage: microbench [options]" << std::endl;
+	std::cerr << "  --families LIST         hash families (default: 1,4,5)" << std::endl;
+	std::cerr << "  --hash-numbers LIST     numbers of hash runs (default: 1,4,8,16)" << std::endl;
+	std::cerr << "  --areas LIST            numbers of areas (default: 255,1000: 1 and 2 bytes cells)" << std::endl;
+	std::cerr << "  --bit-mappings LIST     filter sizes (default: 12,16,20,24,26)" << std::endl;
+	std::cerr << "  --max-elements N        elements inserted and checked per filter (default: 200000)" << std::endl;
+	std::cerr << "  --min-time S            minimum measured time per benchmark (default: 0.05)" << std::endl;
+	std::cerr << "  --salt-prefix PATH      prefix of the hash salt files (default: microbench-salt)" << std::endl;
+	std::cerr << "  --perf                  samples hardware performance counters" << std::endl;
+}
+
+
+std::vector<int> ParseList(const std::string& value) {
+	std::vector<int> list;
+	std::istringstream istr(value);
+	std::string item;
+	while (getline(istr, item, ',')) list.push_back(atoi(item.c_str()));
+	return list;
+}
+
+
+//parses the command line flags; returns false on invalid input
+bool ParseArguments(int argc, char** argv, Settings& s) {
+	s.families = ParseList("1,4,5");
+	s.hash_numbers = ParseList("1,4,8,16");
+	s.areas = ParseList("255,1000");
+	s.bit_mappings = ParseList("12,16,20,24,26");
+	s.max_elements = 200000;
+	s.min_time = 0.05;
+	s.salt_prefix = "microbench-salt";
+	s.perf = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string flag(argv[i]);
+		if (flag == "--perf") {
+			s.perf = true;
+			continue;
+		}
+		if (i + 1 >= argc) return false;
+		std::string value(argv[++i]);
+
+		if (flag == "--families") s.families = ParseList(value);
+		else if (flag == "--hash-numbers") s.hash_numbers = ParseList(value);
+		else if (flag == "--areas") s.areas = ParseList(value);
+		else if (flag == "--bit-mappings") s.bit_mappings = ParseList(value);
+		else if (flag == "--max-elements") s.max_elements = atoll(value.c_str());
+		else if (flag == "--min-time") s.min_time = atof(value.c_str());
+		else if (flag == "--salt-prefix") s.salt_prefix = value;
+		else return false;
+	}
+
+	return s.max_elements > 0 && !s.families.empty() && !s.hash_numbers.empty() && !s.areas.empty() && !s.bit_mappings.empty();
+}
+
+
+//runs fn (which performs ops operations) until min_time has elapsed, and
+//returns the average time (in nanoseconds) and counter values per operation
+template <typename F>
+Result Measure(PerfCounters& perf, double min_time, long long ops, F fn) {
+	Result result;
+	long long calls = 0;
+	double elapsed;
+
+	perf.Start();
+	Clock::time_point start = Clock::now();
+	do {
+		fn();
+		calls++;
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	} while (elapsed < min_time);
+	perf.Stop();
+
+	double total = (double)calls * (double)ops;
+	result.ops = ops;
+	result.ns = elapsed * 1e9 / total;
+	for (int c = 0; c < PerfCounters::COUNT; c++) {
+		result.counters[c] = (perf.Value(c) < 0) ? -1 : perf.Value(c) / total;
+	}
+	return result;
+}
+
+
+//prints one result record
+void Report(const std::string& benchmark, int family, int hash_number, int areas, int bit_mapping, const Result& r) {
+	printf("%s;%d;%d;%d;%d;%d;%lld;%.2f", benchmark.c_str(), family, hash_number, areas, areas <= 255 ? 1 : 2, bit_mapping, r.ops, r.ns);
+	for (int c = 0; c < PerfCounters::COUNT; c++) {
+		if (r.counters[c] < 0) printf(";NA");
+		else printf(";%.3f", r.counters[c]);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+
+//members are "m<index>", non-members "n<index>"; elements are split evenly
+//among the areas, in ascending order of area label
+std::string Element(char prefix, long long index) {
+	char buffer[32];
+	return std::string(buffer, snprintf(buffer, sizeof(buffer), "%c%lld", prefix, index));
+}
+
+
+int main(int argc, char** argv) {
+
+	Settings s;
+	if (!ParseArguments(argc, argv, s)) {
+		Usage();
+		return 1;
+	}
+
+	PerfCounters perf(s.perf);
+	if (s.perf && !perf.Enabled()) std::cerr << "Hardware performance counters are not available" << std::endl;
+
+	printf("benchmark;hash_family;hash_number;area_number;cell_size;bit_mapping;operations;ns_per_op");
+	for (int c = 0; c < PerfCounters::COUNT; c++) printf(";%s_per_op", PerfCounters::Name(c));
+	printf("\n");
+
+	for (size_t h = 0; h < s.hash_numbers.size(); h++) {
+		int hn = s.hash_numbers[h];
+		std::string salt = s.salt_prefix + "-" + std::to_string(hn) + ".txt";
+
+		//salt creation (the file is removed before each run) and loading;
+		//the filter is kept as small as possible to isolate their cost
+		Report("CreateHashSalt", 0, hn, 1, 1, Measure(perf, s.min_time, 1, [&]() {
+			remove(salt.c_str());
+			sbf::SBF filter(1, 4, hn, 1, salt);
+		}));
+		Report("LoadHashSalt", 0, hn, 1, 1, Measure(perf, s.min_time, 1, [&]() {
+			sbf::SBF filter(1, 4, hn, 1, salt);
+		}));
+
+		for (size_t f = 0; f < s.families.size(); f++) {
+		for (size_t a = 0; a < s.areas.size(); a++) {
+		for (size_t b = 0; b < s.bit_mappings.size(); b++) {
+			int hf = s.families[f], areas = s.areas[a], bit_mapping = s.bit_mappings[b];
+			long long cells = 1LL << bit_mapping;
+			long long n = std::min(s.max_elements, std::max(1000LL, cells / 8));
+
+			std::vector<std::string> members(n), non_members(n);
+			std::vector<int> labels(n);
+			for (long long i = 0; i < n; i++) {
+				members[i] = Element('m', i);
+				non_members[i] = Element('n', i);
+				labels[i] = 1 + (int)(i * areas / n);
+			}
+
+			sbf::SBF* filter = NULL;
+			try {
+				filter = new sbf::SBF(bit_mapping, hf, hn, areas, salt);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				return 1;
+			}
+
+			//Insert is measured over a single pass, as filling the filter
+			//again would only produce self-collisions
+			Report("Insert", hf, hn, areas, bit_mapping, Measure(perf, 0, n, [&]() {
+				for (long long i = 0; i < n; i++) filter->Insert(members[i].data(), (int)members[i].size(), labels[i]);
+			}));
+
+			volatile int sink = 0;
+			Report("CheckMember", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, n, [&]() {
+				for (long long i = 0; i < n; i++) sink += filter->Check(members[i].data(), (int)members[i].size());
+			}));
+			Report("CheckNonMember", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, n, [&]() {
+				for (long long i = 0; i < n; i++) sink += filter->Check(non_members[i].data(), (int)non_members[i].size());
+			}));
+
+			//hashing only (Digest) and cell accesses only (CheckDigests)
+			std::vector<unsigned int> digests((size_t)n * hn);
+			Report("Digest", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, n, [&]() {
+				for (long long i = 0; i < n; i++) filter->Digest(members[i].data(), (int)members[i].size(), &digests[(size_t)i * hn]);
+			}));
+			Report("CheckDigests", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, n, [&]() {
+				for (long long i = 0; i < n; i++) sink += filter->CheckDigests(&digests[(size_t)i * hn]);
+			}));
+
+			//statistics
+			volatile float fsink = 0;
+			Report("SetAPrioriAreaFpp", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { filter->SetAPrioriAreaFpp(); }));
+			Report("SetAreaFpp", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { filter->SetAreaFpp(); }));
+			Report("SetAPrioriAreaIsep", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { filter->SetAPrioriAreaIsep(); }));
+			Report("SetAreaIsep", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { filter->SetAreaIsep(); }));
+			Report("SetExpectedAreaCells", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { filter->SetExpectedAreaCells(); }));
+			Report("GetFilterSparsity", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { fsink += filter->GetFilterSparsity(); }));
+			Report("GetFilterFpp", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { fsink += filter->GetFilterFpp(); }));
+			Report("GetFilterAPrioriFpp", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { fsink += filter->GetFilterAPrioriFpp(); }));
+			Report("GetAreaMembers", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, areas, [&]() {
+				for (int j = 1; j <= areas; j++) sink += filter->GetAreaMembers(j);
+			}));
+			Report("GetExpectedAreaEmersion", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, areas, [&]() {
+				for (int j = 1; j <= areas; j++) fsink += filter->GetExpectedAreaEmersion(j);
+			}));
+			Report("GetAreaEmersion", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, areas, [&]() {
+				for (int j = 1; j <= areas; j++) fsink += filter->GetAreaEmersion(j);
+			}));
+
+			//serialization (cells are reported per cell, metadata per file)
+			std::string path = s.salt_prefix + "-save.csv";
+			Report("SaveToDiskCells", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, cells, [&]() { filter->SaveToDisk(path, 0); }));
+			Report("SaveToDiskStats", hf, hn, areas, bit_mapping, Measure(perf, s.min_time, 1, [&]() { filter->SaveToDisk(path, 1); }));
+			remove(path.c_str());
+
+			(void)sink;
+			(void)fsink;
+			delete filter;
+		}
+		}
+		}
+
+		remove(salt.c_str());
+	}
+
+	return 0;
+}
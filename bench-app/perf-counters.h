@@ -0,0 +1,138 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+//Optional hardware performance counters for the benchmark applications,
+//read through the Linux perf_event_open interface around a measured region.
+//Each counter is opened on its own, so that the ones which are not supported
+//by the processor (or not allowed by perf_event_paranoid, or not available on
+//other platforms) are simply reported as missing. Counters follow the threads
+//spawned inside the region, and are scaled when the kernel multiplexes them.
+class PerfCounters {
+
+public:
+	enum { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, COUNT };
+
+	//returns the name of the counter, as used in the benchmark outputs
+	static const char* Name(int counter) {
+		static const char* names[COUNT] = { "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses" };
+		return names[counter];
+	}
+
+	PerfCounters(bool enabled) {
+		for (int c = 0; c < COUNT; c++) {
+			fd[c] = -1;
+			value[c] = -1;
+		}
+#ifdef __linux__
+		if (!enabled) return;
+		const unsigned long long cache_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		fd[CYCLES] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		fd[INSTRUCTIONS] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		fd[L1D_MISSES] = Open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache_miss);
+		fd[LLC_MISSES] = Open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cache_miss);
+		fd[DTLB_MISSES] = Open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | cache_miss);
+		fd[BRANCH_MISSES] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#else
+		(void)enabled;
+#endif
+	}
+
+	~PerfCounters() {
+#ifdef __linux__
+		for (int c = 0; c < COUNT; c++) if (fd[c] >= 0) close(fd[c]);
+#endif
+	}
+
+	//returns true if at least one counter could be opened
+	bool Enabled() const {
+		for (int c = 0; c < COUNT; c++) if (fd[c] >= 0) return true;
+		return false;
+	}
+
+	//resets and starts the counters
+	void Start() {
+#ifdef __linux__
+		for (int c = 0; c < COUNT; c++) {
+			if (fd[c] < 0) continue;
+			ioctl(fd[c], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd[c], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	//stops the counters and reads their values
+	void Stop() {
+		for (int c = 0; c < COUNT; c++) {
+			value[c] = -1;
+#ifdef __linux__
+			if (fd[c] < 0) continue;
+			ioctl(fd[c], PERF_EVENT_IOC_DISABLE, 0);
+			unsigned long long data[3];
+			if (read(fd[c], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0) continue;
+			//scales the count if the counter was multiplexed
+			value[c] = (double)data[0] * ((double)data[1] / (double)data[2]);
+#endif
+		}
+	}
+
+	//returns the value of the counter over the last region, or a negative
+	//value if the counter is not available
+	double Value(int counter) const {
+		return value[counter];
+	}
+
+private:
+	int fd[COUNT];
+	double value[COUNT];
+
+#ifdef __linux__
+	static int Open(unsigned int type, unsigned long long config) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+#endif
+};
+
+#endif /* PERF_COUNTERS_H */
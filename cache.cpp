@@ -0,0 +1,290 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#define SBF_DLL
+
+#include "cache.h"
+
+#include <random>
+#include <stdexcept>
+#include <string.h>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// Key of the free slots
+const uint64_t EMPTY = 0;
+
+// Layout of a set (one cache line): the sequence number, odd while a writer
+// updates the set, the CLOCK hand, then a key and a value word per way
+const int SET_WORDS = 8;
+const int SEQUENCE = 0;
+const int HAND = 1;
+const int FIRST_SLOT = 2;
+
+// Layout of the value word: reference bit, area label, filter version
+const uint64_t REFERENCED = 1;
+const int AREA_SHIFT = 1;
+const uint64_t AREA_MASK = 0xFFFF;
+const int VERSION_SHIFT = 17;
+const uint64_t VERSION_MASK = (1ULL << (64 - VERSION_SHIFT)) - 1;
+
+// The hit and miss counters are striped over cache lines, each thread
+// counting on its own stripe
+const int STRIPES = 16;
+const int STRIPE_WORDS = 8;
+
+std::atomic<int> next_stripe(0);
+
+int ThreadStripe()
+{
+    static thread_local int stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+    return stripe;
+}
+
+
+// SplitMix64 finalizer
+uint64_t Mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+// Fingerprints never collide with the key of the free slots
+uint64_t Key(uint64_t fingerprint)
+{
+    return (fingerprint != EMPTY) ? fingerprint : 1;
+}
+
+} //namespace
+
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+// The number of slots is rounded up to a power of two number of sets of
+// WAYS slots.
+// Empty slots are skipped by Lookup, so the table needs no warm-up.
+CheckCache::CheckCache(int slots)
+{
+    if (slots <= 0) throw std::invalid_argument("Invalid number of cache slots.");
+
+    long long sets = 1;
+    while (sets * CheckCache::WAYS < slots) sets <<= 1;
+    if (sets > (1LL << 26)) throw std::invalid_argument("Invalid number of cache slots.");
+
+    // Aligned so that each set fills a single cache line
+    this->storage = new std::atomic<uint64_t>[sets * SET_WORDS + SET_WORDS];
+    this->words = this->storage + ((64 - ((uintptr_t)this->storage & 63)) & 63) / sizeof(uint64_t);
+    this->set_mask = (uint64_t)(sets - 1);
+    this->counters = new std::atomic<long long>[STRIPES * STRIPE_WORDS];
+
+    std::random_device random;
+    this->seed = ((uint64_t)random() << 32) ^ (uint64_t)random();
+
+    this->Clear();
+}
+
+
+CheckCache::~CheckCache()
+{
+    delete[] storage;
+    delete[] counters;
+}
+
+
+// Computes the seeded 64-bit fingerprint of an element, reading it 8 bytes
+// at a time. The seed is drawn per cache, so that colliding elements cannot
+// be crafted ahead of time.
+// char *string     the element
+// int size         length of the element
+uint64_t CheckCache::Fingerprint(const char *string, int size) const
+{
+    uint64_t hash = this->seed ^ Mix((uint64_t)size);
+    uint64_t word;
+
+    for (; size >= 8; size -= 8, string += 8) {
+        memcpy(&word, string, 8);
+        hash = (hash ^ Mix(word)) * 0x9E3779B97F4A7C15ULL;
+    }
+    if (size > 0) {
+        word = 0;
+        memcpy(&word, string, size);
+        hash = (hash ^ Mix(word)) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    return Mix(hash);
+}
+
+
+// Looks up an element by fingerprint. Returns true, and the cached area, if
+// the element was stored against the given filter version. The set is read
+// under its sequence number, and a writer updating it meanwhile makes the
+// lookup a miss.
+// uint64_t fingerprint  the element fingerprint (see Fingerprint)
+// uint64_t version      the current filter version
+// int *area             output area label
+bool CheckCache::Lookup(uint64_t fingerprint, uint64_t version, int *area)
+{
+    uint64_t key = Key(fingerprint);
+    std::atomic<uint64_t> *set = this->words + (key & this->set_mask) * SET_WORDS;
+    std::atomic<long long> *counters = this->counters + ThreadStripe() * STRIPE_WORDS;
+
+    uint64_t sequence = set[SEQUENCE].load(std::memory_order_acquire);
+    if ((sequence & 1) == 0) {
+        for (int w = 0; w < CheckCache::WAYS; w++) {
+            std::atomic<uint64_t> *slot = set + FIRST_SLOT + 2 * w;
+            if (slot[0].load(std::memory_order_relaxed) != key) continue;
+
+            // The key and value are only consistent if no writer got hold of
+            // the set since the sequence number was read
+            uint64_t value = slot[1].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (set[SEQUENCE].load(std::memory_order_relaxed) != sequence) break;
+            if ((value >> VERSION_SHIFT) != (version & VERSION_MASK)) break;
+
+            if ((value & REFERENCED) == 0) slot[1].fetch_or(REFERENCED, std::memory_order_relaxed);
+            *area = (int)((value >> AREA_SHIFT) & AREA_MASK);
+            counters[0].fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    counters[1].fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+
+// Caches the area of an element, computed against the given filter version.
+// The entry replaces a stale or free slot of its set if any, or the first
+// slot not referenced since the hand last swept it. New entries start
+// unreferenced, so that elements queried once are the first to go.
+// The writer takes the set by making its sequence number odd, and gives up
+// (the result is simply not cached) if another writer holds it.
+// uint64_t fingerprint  the element fingerprint (see Fingerprint)
+// uint64_t version      the filter version the area was computed against
+// int area             the area label
+void CheckCache::Store(uint64_t fingerprint, uint64_t version, int area)
+{
+    uint64_t key = Key(fingerprint);
+    std::atomic<uint64_t> *set = this->words + (key & this->set_mask) * SET_WORDS;
+    uint64_t value = ((version & VERSION_MASK) << VERSION_SHIFT) | (((uint64_t)area & AREA_MASK) << AREA_SHIFT);
+
+    uint64_t sequence = set[SEQUENCE].load(std::memory_order_relaxed);
+    if ((sequence & 1) != 0 || !set[SEQUENCE].compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire)) return;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::atomic<uint64_t> *slots = set + FIRST_SLOT;
+    int victim = -1;
+
+    for (int w = 0; w < CheckCache::WAYS && victim < 0; w++) {
+        uint64_t current = slots[2 * w].load(std::memory_order_relaxed);
+        if (current == EMPTY || current == key) victim = w;
+        else if ((slots[2 * w + 1].load(std::memory_order_relaxed) >> VERSION_SHIFT) != (version & VERSION_MASK)) victim = w;
+    }
+
+    // CLOCK sweep: gives each referenced way a second chance, so that at
+    // most one full turn plus one step is needed
+    if (victim < 0) {
+        uint64_t hand = set[HAND].load(std::memory_order_relaxed);
+        for (int step = 0; step <= CheckCache::WAYS; step++, hand++) {
+            std::atomic<uint64_t> &slot_value = slots[2 * (hand % CheckCache::WAYS) + 1];
+            if ((slot_value.load(std::memory_order_relaxed) & REFERENCED) == 0) {
+                victim = (int)(hand % CheckCache::WAYS);
+                break;
+            }
+            slot_value.fetch_and(~REFERENCED, std::memory_order_relaxed);
+        }
+        if (victim < 0) victim = (int)(hand % CheckCache::WAYS);
+        set[HAND].store((uint64_t)(victim + 1), std::memory_order_relaxed);
+    }
+
+    slots[2 * victim].store(key, std::memory_order_relaxed);
+    slots[2 * victim + 1].store(value, std::memory_order_relaxed);
+    set[SEQUENCE].store(sequence + 2, std::memory_order_release);
+}
+
+
+// Empties the cache and resets the counters. Must not be called together
+// with Lookup or Store.
+void CheckCache::Clear()
+{
+    long long sets = (long long)this->set_mask + 1;
+
+    for (long long i = 0; i < sets * SET_WORDS; i++) this->words[i].store(0, std::memory_order_relaxed);
+    for (int i = 0; i < STRIPES * STRIPE_WORDS; i++) this->counters[i].store(0, std::memory_order_relaxed);
+}
+
+
+// Returns the number of slots
+long long CheckCache::GetSlots() const
+{
+    return ((long long)this->set_mask + 1) * CheckCache::WAYS;
+}
+
+
+// Returns the number of lookups answered by the cache
+long long CheckCache::GetHits() const
+{
+    long long hits = 0;
+    for (int s = 0; s < STRIPES; s++) hits += this->counters[s * STRIPE_WORDS].load(std::memory_order_relaxed);
+    return hits;
+}
+
+
+// Returns the number of lookups not answered by the cache (including stale
+// entries)
+long long CheckCache::GetMisses() const
+{
+    long long misses = 0;
+    for (int s = 0; s < STRIPES; s++) misses += this->counters[s * STRIPE_WORDS + 1].load(std::memory_order_relaxed);
+    return misses;
+}
+
+
+// Returns the fraction of lookups answered by the cache (0 if none)
+double CheckCache::GetHitRate() const
+{
+    long long hits = this->GetHits();
+    long long lookups = hits + this->GetMisses();
+    return (lookups == 0) ? 0 : (double)hits / (double)lookups;
+}
+
+
+// Returns the allocated bytes
+size_t CheckCache::GetBytes() const
+{
+    long long sets = (long long)this->set_mask + 1;
+    return sizeof(CheckCache) + (size_t)(sets * SET_WORDS + SET_WORDS) * sizeof(uint64_t) + STRIPES * STRIPE_WORDS * sizeof(long long);
+}
+
+} //namespace sbf
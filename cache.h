@@ -0,0 +1,98 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#pragma once
+
+#ifndef CACHE_H
+#define CACHE_H
+
+// OS specific headers
+#if defined(__MINGW32__) || defined(__MINGW64__)
+#include "win/libexport.h"
+#elif defined(_MSC_VER)
+#include "win/libexport.h"
+#elif __GNUC__
+#include "linux/libexport.h"
+#endif
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace sbf {
+
+	// Cache of Check results, enabled through SBF::EnableCache, for workloads
+	// where a few hot elements make up most of the queries. Elements are
+	// keyed by a seeded 64-bit fingerprint of their bytes (so that the k
+	// hash computations are skipped on a hit) and each entry stores the
+	// resolved area together with the filter version it was computed
+	// against: since Insert bumps the version, entries are invalidated
+	// without touching the table.
+	// The slots are grouped in sets of WAYS, one cache line each, and
+	// replaced with CLOCK: a hit sets the reference bit of the entry, and a
+	// miss evicts the first unreferenced way of the set, clearing reference
+	// bits as the per-set hand sweeps. Lookup and Store may be called
+	// concurrently: each set is a seqlock, whose sequence number a writer
+	// makes odd with a single CAS (giving up, so that the result is simply
+	// not cached, if another writer holds it), and readers never block nor
+	// write unless they set a reference bit, treating a set written while
+	// they read it as a miss. A hit thus always returns the area stored
+	// for the same fingerprint; two distinct elements share a fingerprint
+	// with probability 2^-64.
+	class DLL_PUBLIC CheckCache
+	{
+
+	private:
+		std::atomic<uint64_t> *storage;
+		std::atomic<uint64_t> *words;
+		uint64_t set_mask;
+		uint64_t seed;
+		std::atomic<long long> *counters;
+
+		CheckCache(const CheckCache &);
+		CheckCache &operator=(const CheckCache &);
+
+	public:
+		// The number of slots of each set (3 slots of 16 bytes, after the
+		// sequence number and CLOCK hand of the set, fill a cache line)
+		const static int WAYS = 3;
+
+		CheckCache(int slots);
+		~CheckCache();
+
+		// Public methods (commented in the cache.cpp)
+		uint64_t Fingerprint(const char *string, int size) const;
+		bool Lookup(uint64_t fingerprint, uint64_t version, int *area);
+		void Store(uint64_t fingerprint, uint64_t version, int area);
+		void Clear();
+		long long GetSlots() const;
+		long long GetHits() const;
+		long long GetMisses() const;
+		double GetHitRate() const;
+		size_t GetBytes() const;
+	};
+
+} //namespace sbf
+
+#endif /* CACHE_H */
@@ -0,0 +1,107 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <istream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+
+namespace sbf {
+
+	// Internal helpers to read the test datasets (one element per line,
+	// optionally prefixed by its area label and a delimiter) in blocks of
+	// whole lines, shared by the ingestion and evaluation routines
+
+
+	// Reads from the stream the next block of (about block_size bytes of)
+	// whole lines. The trailing partial line is kept in carry and prepended
+	// to the next block. Returns false when the stream is exhausted and no
+	// data is left.
+	inline bool ReadBlock(std::istream &in, int block_size, std::string &carry, std::string &block)
+	{
+		block.swap(carry);
+		carry.clear();
+
+		while (in.good()) {
+			size_t offset = block.size();
+			block.resize(offset + block_size);
+			in.read(&block[offset], block_size);
+			block.resize(offset + (size_t)in.gcount());
+
+			size_t last = block.rfind('\n');
+			if (last != std::string::npos && last >= offset) {
+				carry.assign(block, last + 1, std::string::npos);
+				block.resize(last + 1);
+				break;
+			}
+		}
+
+		return !block.empty();
+	}
+
+
+	// Calls fn(line, length) for every non-empty line in [begin, end) of the
+	// block, without the line terminator
+	template <typename F>
+	void ForEachLine(const char *begin, const char *end, F fn)
+	{
+		while (begin < end) {
+			const char *eol = (const char *)memchr(begin, '\n', end - begin);
+			if (eol == NULL) eol = end;
+			if (eol > begin) fn(begin, (size_t)(eol - begin));
+			begin = eol + 1;
+		}
+	}
+
+
+	template <typename F>
+	void ForEachLine(const std::string &block, F fn)
+	{
+		ForEachLine(block.data(), block.data() + block.size(), fn);
+	}
+
+
+	// Splits a dataset line into its area label and element, the same way the
+	// test application does: the element is whatever follows the first
+	// delimiter (or the whole line, if no delimiter is found).
+	inline int ParseLine(const char *line, size_t length, char delimiter, const char *&element, int &element_length)
+	{
+		const char *sep = (const char *)memchr(line, delimiter, length);
+		if (sep == NULL) {
+			element = line;
+			element_length = (int)length;
+		}
+		else {
+			element = sep + 1;
+			element_length = (int)(length - (sep + 1 - line));
+		}
+		return atoi(std::string(line, sep == NULL ? length : sep - line).c_str());
+	}
+
+} //namespace sbf
+
+#endif /* DATASET_H */
@@ -0,0 +1,204 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sbflib.h>
+#include <ingest.h>
+#include <paillier.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+
+//This program builds a SBF over a construction dataset and encrypts all of
+//its cells with Paillier, for private membership protocols in which the
+//encrypted filter is handed to an untrusted party. The key pair is loaded
+//from --key, or generated there when the file does not exist (the file
+//then holds the private key and is only readable by its owner); the public
+//key alone can be exported with --public-key.
+//With --precompute, the randomness of all the cells is computed before
+//the encryption (as it would be offline), and both phases are timed.
+//With --pack, many cells are packed into each ciphertext.
+
+
+typedef std::chrono::steady_clock Clock;
+
+
+//encryption settings, as read from the command line
+struct Settings {
+	std::string dataset;
+	std::string salt;
+	std::string key;
+	std::string public_key;
+	std::string output;
+	char delimiter;
+	int hash_family;
+	int hash_number;
+	int bit_mapping;
+	double fpp;
+	int key_bits;
+	int threads;
+	int guard_bits;
+	bool precompute;
+};
+
+
+void Usage() {
+	std::cerr << "Usage: encrypt-app --dataset FILE [options]" << std::endl;
+	std::cerr << "  --dataset FILE          construction dataset (area,element per line; - for stdin)" << std::endl;
+	std::cerr << "  --hash-family N         1 (SHA1), 4 (MD4), 5 (MD5) (default: 4)" << std::endl;
+	std::cerr << "  --hash-number N         number of hash runs (default: derived from --fpp)" << std::endl;
+	std::cerr << "  --bit-mapping N         filter size exponent (default: derived from --fpp)" << std::endl;
+	std::cerr << "  --fpp P                 target false positives probability (default: 0.001)" << std::endl;
+	std::cerr << "  --salt FILE             hash salt file, created if missing (default: SBFHashSalt.txt)" << std::endl;
+	std::cerr << "  --delimiter C           dataset delimiter (default: ,)" << std::endl;
+	std::cerr << "  --key FILE              Paillier key pair, generated if missing (default: paillier.key)" << std::endl;
+	std::cerr << "  --key-bits N            size of a generated modulus in bits (default: 2048)" << std::endl;
+	std::cerr << "  --public-key FILE       also saves the public key alone" << std::endl;
+	std::cerr << "  --output FILE           encrypted filter (default: filter.enc)" << std::endl;
+	std::cerr << "  --threads N             worker threads, 0 for all hardware threads (default: 0)" << std::endl;
+	std::cerr << "  --precompute            computes all the randomness before encrypting" << std::endl;
+	std::cerr << "  --pack G                packs many cells per ciphertext, with G guard bits per cell" << std::endl;
+}
+
+
+//parses the command line flags; returns false on invalid input
+bool ParseArguments(int argc, char** argv, Settings& s) {
+	s.salt = "SBFHashSalt.txt";
+	s.key = "paillier.key";
+	s.output = "filter.enc";
+	s.delimiter = ',';
+	s.hash_family = 4;
+	s.hash_number = 0;
+	s.bit_mapping = 0;
+	s.fpp = 0.001;
+	s.key_bits = 2048;
+	s.threads = 0;
+	s.guard_bits = -1;
+	s.precompute = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string flag(argv[i]);
+		if (flag == "--precompute") {
+			s.precompute = true;
+			continue;
+		}
+		if (i + 1 >= argc) return false;
+		std::string value(argv[++i]);
+
+		if (flag == "--dataset") s.dataset = value;
+		else if (flag == "--hash-family") s.hash_family = atoi(value.c_str());
+		else if (flag == "--hash-number") s.hash_number = atoi(value.c_str());
+		else if (flag == "--bit-mapping") s.bit_mapping = atoi(value.c_str());
+		else if (flag == "--fpp") s.fpp = atof(value.c_str());
+		else if (flag == "--salt") s.salt = value;
+		else if (flag == "--delimiter") s.delimiter = value.empty() ? ',' : value[0];
+		else if (flag == "--key") s.key = value;
+		else if (flag == "--key-bits") s.key_bits = atoi(value.c_str());
+		else if (flag == "--public-key") s.public_key = value;
+		else if (flag == "--output") s.output = value;
+		else if (flag == "--threads") s.threads = atoi(value.c_str());
+		else if (flag == "--pack") s.guard_bits = atoi(value.c_str());
+		else return false;
+	}
+
+	return !s.dataset.empty();
+}
+
+
+double Seconds(const Clock::time_point& start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+int main(int argc, char** argv) {
+
+	Settings s;
+	if (!ParseArguments(argc, argv, s)) {
+		Usage();
+		return 1;
+	}
+
+	sbf::IngestOptions options;
+	options.HASH_family = s.hash_family;
+	options.HASH_number = s.hash_number;
+	options.bit_mapping = s.bit_mapping;
+	options.max_fpp = s.fpp;
+	options.salt_path = s.salt;
+	options.delimiter = s.delimiter;
+	options.threads = s.threads;
+
+	sbf::SBF* myFilter = NULL;
+	sbf::PaillierKey key;
+	Clock::time_point start;
+
+	try {
+		sbf::Ingest ingest(options);
+		myFilter = ingest.Run(s.dataset);
+		std::cout << "Filter: " << ingest.GetMembers() << " elements, " << ingest.GetAreaNumber() << " areas, 2^"
+			<< myFilter->GetBitMapping() << " cells" << std::endl;
+
+		std::ifstream keyfile(s.key.c_str());
+		if (keyfile.good()) {
+			keyfile.close();
+			key.LoadFromDisk(s.key);
+		}
+		else {
+			start = Clock::now();
+			key.Generate(s.key_bits);
+			key.SaveToDisk(s.key, true);
+			std::cout << "Key generated in " << Seconds(start) << " s (" << s.key << ")" << std::endl;
+		}
+		if (!s.public_key.empty()) key.SaveToDisk(s.public_key, false);
+
+		sbf::PaillierEncryptor encryptor(key, s.threads);
+		encryptor.SetPacking(s.guard_bits);
+		if (s.precompute) {
+			//one randomizer per ciphertext
+			long long ciphertexts = 1LL << myFilter->GetBitMapping();
+			if (s.guard_bits >= 0) {
+				int slot_bits = sbf::EncryptedHeader::LabelBits(myFilter->GetAreaNumber()) + s.guard_bits;
+				int slots = (key.GetModulusBytes() * 8 - 1) / slot_bits;
+				if (slots > 1) ciphertexts = (ciphertexts + slots - 1) / slots;
+			}
+			start = Clock::now();
+			encryptor.PrecomputeRandomness(ciphertexts);
+			std::cout << "Randomness precomputed in " << Seconds(start) << " s" << std::endl;
+		}
+
+		start = Clock::now();
+		encryptor.Encrypt(myFilter, s.output);
+		double seconds = Seconds(start);
+		std::cout << "Filter encrypted in " << seconds << " s (" << ((1LL << myFilter->GetBitMapping()) / seconds) << " cells/s, "
+			<< s.output << ")" << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		delete myFilter;
+		return 1;
+	}
+
+	delete myFilter;
+	return 0;
+}
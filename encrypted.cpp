@@ -0,0 +1,284 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define SBF_DLL
+
+#include "encrypted.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <openssl/rand.h>
+#include <stdexcept>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// Returns a uniform random value in [0, bound)
+unsigned int RandomBelow(unsigned int bound)
+{
+    unsigned int limit = 0xFFFFFFFFu - (0xFFFFFFFFu % bound);
+    unsigned int value;
+    do {
+        if (RAND_bytes((unsigned char*)&value, sizeof(value)) != 1) throw std::runtime_error("Random number generation failed.");
+    } while (value >= limit);
+    return value % bound;
+}
+
+} //namespace
+
+
+/* ***************************** QUERY METHODS ***************************** */
+
+
+EncryptedQuery::EncryptedQuery()
+{
+    this->area = 0;
+}
+
+
+// Sets the indices to the cells of the input element, as hashed by a filter
+// built with the same settings and salts as the encrypted one (its cells are
+// not read)
+void EncryptedQuery::SetElement(const SBF &hasher, const char *string, const int size)
+{
+    this->indices.resize(hasher.GetHashNumber());
+    hasher.Digest(string, size, &this->indices[0]);
+    for (size_t k = 0; k < this->indices.size(); k++) {
+        this->indices[k] >>= (SBF::MAX_BIT_MAPPING - hasher.GetBitMapping());
+    }
+}
+
+
+/* ************************* ENCRYPTED FILTER METHODS ********************** */
+
+
+// Loads the encrypted filter from a file (path)
+EncryptedSBF::EncryptedSBF(const std::string &path, int threads) : pool(key, threads)
+{
+    std::ifstream myfile(path.c_str(), std::ios::binary);
+    if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+
+    this->threads = ThreadCount(threads);
+    this->Load(myfile);
+}
+
+
+// Loads the encrypted filter from a stream
+EncryptedSBF::EncryptedSBF(std::istream &in, int threads) : pool(key, threads)
+{
+    this->threads = ThreadCount(threads);
+    this->Load(in);
+}
+
+
+EncryptedSBF::~EncryptedSBF()
+{
+    for (size_t t = 0; t < this->contexts.size(); t++) delete this->contexts[t];
+}
+
+
+// Reads the header and the cells, and sets up a context for each thread
+void EncryptedSBF::Load(std::istream &in)
+{
+    this->header.Read(in);
+    this->key.SetPublic(&this->header.modulus[0], (int)this->header.modulus.size());
+    this->bytes = this->header.GetCiphertextBytes();
+
+    this->cells.resize((size_t)(this->header.GetCiphertexts() * this->bytes));
+    if (!in.read((char*)&this->cells[0], (std::streamsize)this->cells.size())) throw std::runtime_error("Truncated encrypted filter.");
+
+    for (int t = 0; t < this->threads; t++) this->contexts.push_back(new PaillierContext(this->key));
+}
+
+
+// Returns the settings of the encrypted filter
+const EncryptedHeader &EncryptedSBF::GetHeader() const
+{
+    return this->header;
+}
+
+
+// Returns the public key the filter was encrypted with
+const PaillierKey &EncryptedSBF::GetKey() const
+{
+    return this->key;
+}
+
+
+// Computes count randomizers s^n mod n^2 ahead of time (e.g. while idle),
+// to be used by the next batches
+void EncryptedSBF::PrecomputeRandomness(long long count)
+{
+    this->pool.Precompute(count);
+}
+
+
+// Returns the number of precomputed randomizers not yet used
+long long EncryptedSBF::GetPoolSize() const
+{
+    return this->pool.GetSize();
+}
+
+
+// Answers a batch of queries (see EncryptedQuery): responses[q] receives the
+// ciphertexts of query q, one per index (the one holding the cell, with a
+// packed filter), each as a big-endian number of 2 * modulus bytes (see
+// EncryptedHeader).
+void EncryptedSBF::Answer(const std::vector<EncryptedQuery> &queries, std::vector<std::vector<unsigned char> > &responses)
+{
+    const long long cells = this->header.GetCells();
+    const int AREA_number = this->header.AREA_number;
+    const int slots = this->header.slots;
+    const int slot_bits = this->header.slot_bits;
+    const bool masked = slots > 1 && this->header.guard_bits > 0;
+    const int bytes = this->bytes;
+    const BIGNUM *n = this->key.GetN();
+    const BIGNUM *n2 = this->key.GetN2();
+
+    // Flattens the batch into (query, cell) items, and computes once the
+    // g^-area = 1 - area * n (mod n^2) factors of the areas tested
+    std::vector<long long> first(queries.size() + 1, 0);
+    std::vector<BIGNUM*> offsets(AREA_number + 1, (BIGNUM*)NULL);
+    bool ok = true;
+    for (size_t q = 0; q < queries.size(); q++) {
+        const EncryptedQuery &query = queries[q];
+        if (query.area < 0 || query.area > AREA_number || (query.area > 0 && slots > 1)) ok = false;
+        for (size_t k = 0; k < query.indices.size(); k++) {
+            if ((long long)query.indices[k] >= cells) ok = false;
+        }
+        if (ok && query.area > 0 && offsets[query.area] == NULL) {
+            BIGNUM *offset = BN_new();
+            offsets[query.area] = offset;
+            ok = offset != NULL && BN_copy(offset, n) != NULL && BN_mul_word(offset, (BN_ULONG)query.area) &&
+                BN_sub(offset, n2, offset) && BN_add_word(offset, 1);
+        }
+        first[q + 1] = first[q] + (long long)query.indices.size();
+    }
+    if (!ok) {
+        for (int a = 0; a <= AREA_number; a++) BN_free(offsets[a]);
+        throw std::invalid_argument("Invalid encrypted query.");
+    }
+
+    responses.resize(queries.size());
+    for (size_t q = 0; q < queries.size(); q++) responses[q].resize(queries[q].indices.size() * bytes);
+
+    std::atomic<bool> failed(false);
+    ParallelFor(this->threads, first[queries.size()], [&](int t, long long begin, long long end) {
+        PaillierContext &context = *this->contexts[t];
+        BN_CTX *ctx = context.ctx;
+        BN_CTX_start(ctx);
+        BIGNUM *x = BN_CTX_get(ctx);
+        BIGNUM *rho = BN_CTX_get(ctx);
+        BIGNUM *s = BN_CTX_get(ctx);
+        BIGNUM *out = BN_CTX_get(ctx);
+        BIGNUM *mask = BN_CTX_get(ctx);
+        if (out == NULL) failed = true;
+
+        size_t q = std::upper_bound(first.begin(), first.end(), begin) - first.begin() - 1;
+        for (long long item = begin; item < end && !failed; item++) {
+            while (item >= first[q + 1]) q++;
+            const EncryptedQuery &query = queries[q];
+            long long k = item - first[q];
+            unsigned char *response = &responses[q][(size_t)(k * bytes)];
+
+            long long pooled;
+            const unsigned char *randomizer = this->pool.Take(1, pooled);
+            unsigned int index = query.indices[k];
+            bool done = BN_bin2bn(&this->cells[(size_t)((long long)(index / slots) * bytes)], bytes, x) != NULL;
+
+            if (masked) {
+                // The other slots get random values below 2^(slot_bits - 1),
+                // which cannot carry into the next slot; x *= 1 + mask*n
+                int slot = (int)(index % slots);
+                done = done && BN_rand(mask, slots * slot_bits, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+                for (int t = 0; done && t < slots; t++) {
+                    if (t != slot) {
+                        BN_clear_bit(mask, (t + 1) * slot_bits - 1);
+                        continue;
+                    }
+                    for (int b = t * slot_bits; b < (t + 1) * slot_bits; b++) BN_clear_bit(mask, b);
+                }
+                done = done && BN_mul(mask, mask, n, ctx) && BN_add_word(mask, 1) && BN_mod_mul(x, x, mask, n2, ctx);
+            }
+
+            if (query.area == 0) {
+                // E(c) * s^n
+                if (pooled > 0) {
+                    done = done && BN_bin2bn(randomizer, bytes, s) != NULL;
+                }
+                else {
+                    done = done && this->key.Randomizer(s, ctx, context.mont_n2, context.mont_p2, context.mont_q2);
+                }
+                done = done && BN_mod_mul(out, x, s, n2, ctx);
+            }
+            else {
+                // (E(c) * g^-area)^rho * s^n, with rho uniform in [1, n)
+                done = done && BN_mod_mul(x, x, offsets[query.area], n2, ctx);
+                while (done) {
+                    done = BN_rand_range(rho, n);
+                    if (!BN_is_zero(rho)) break;
+                }
+                if (pooled > 0) {
+                    done = done && BN_bin2bn(randomizer, bytes, s) != NULL &&
+                        BN_mod_exp_mont(out, x, rho, n2, ctx, context.mont_n2) && BN_mod_mul(out, out, s, n2, ctx);
+                }
+                else {
+                    while (done) {
+                        done = BN_rand_range(s, n);
+                        if (!BN_is_zero(s)) break;
+                    }
+                    done = done && BN_mod_exp2_mont(out, x, rho, s, n, n2, ctx, context.mont_n2);
+                }
+            }
+
+            if (!done || BN_bn2binpad(out, response, bytes) != bytes) failed = true;
+        }
+
+        BN_CTX_end(ctx);
+    });
+
+    for (int a = 0; a <= AREA_number; a++) BN_free(offsets[a]);
+    if (failed) throw std::runtime_error("Unable to answer the encrypted queries.");
+
+    // Equality tests are shuffled, so that the position of a matching cell
+    // does not tell which hash function hit it
+    std::vector<unsigned char> swap(bytes);
+    for (size_t q = 0; q < queries.size(); q++) {
+        if (queries[q].area == 0) continue;
+        for (size_t k = queries[q].indices.size(); k > 1; k--) {
+            size_t j = RandomBelow((unsigned int)k);
+            if (j == k - 1) continue;
+            unsigned char *a = &responses[q][(k - 1) * bytes];
+            unsigned char *b = &responses[q][j * bytes];
+            memcpy(&swap[0], a, bytes);
+            memcpy(a, b, bytes);
+            memcpy(b, &swap[0], bytes);
+        }
+    }
+}
+
+} //namespace sbf
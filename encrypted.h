@@ -0,0 +1,103 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef ENCRYPTED_H
+#define ENCRYPTED_H
+
+#include "paillier.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+
+namespace sbf {
+
+	// A private query on an encrypted filter: the cell indices of an element
+	// (computed by the client, see SetElement) and the operation to apply.
+	struct DLL_PUBLIC EncryptedQuery
+	{
+		// Indices of the cells to be combined
+		std::vector<unsigned int> indices;
+		// 0: each cell ciphertext is returned re-randomized, so that the key
+		// holder can decrypt the labels (and take their minimum, as Check)
+		// without linking them to the stored ciphertexts. With a packed
+		// filter, the ciphertext holding the cell is returned, with the
+		// other slots masked by random values if the filter has guard bits;
+		// the label is recovered by EncryptedHeader::ExtractCell.
+		// An area label (one cell per ciphertext only): each cell c is
+		// returned as E(rho * (c - area)), with a fresh random rho for each
+		// cell, in shuffled order, so that only the cells holding that area
+		// decrypt to 0 and the others decrypt to random values.
+		int area;
+
+		EncryptedQuery();
+
+		void SetElement(const SBF &hasher, const char *string, const int size);
+	};
+
+
+	// Server side of the private-query protocol: an encrypted filter (as
+	// written by PaillierEncryptor) held without the private key, answering
+	// batches of queries with homomorphic operations on the requested cells.
+	// A batch shares the per-area constants and the randomness pool, its
+	// cells are processed in parallel, and each worker keeps the same
+	// PaillierContext (and Montgomery context) across batches. Blinded cells
+	// are computed with a single double exponentiation,
+	// (c * g^-area)^rho * s^n mod n^2, while the masks of the packed cells
+	// are added as (1 + mask*n). Batches are answered one at a time
+	// (Answer is not reentrant).
+	class DLL_PUBLIC EncryptedSBF
+	{
+
+	private:
+		EncryptedHeader header;
+		PaillierKey key;
+		int threads;
+		int bytes;
+		std::vector<unsigned char> cells;
+		RandomnessPool pool;
+		std::vector<PaillierContext*> contexts;
+
+		// Private methods (commented in the encrypted.cpp)
+		void Load(std::istream &in);
+
+		EncryptedSBF(const EncryptedSBF &);
+		EncryptedSBF &operator=(const EncryptedSBF &);
+
+	public:
+		EncryptedSBF(const std::string &path, int threads);
+		EncryptedSBF(std::istream &in, int threads);
+		~EncryptedSBF();
+
+		// Public methods (commented in the encrypted.cpp)
+		const EncryptedHeader &GetHeader() const;
+		const PaillierKey &GetKey() const;
+		void PrecomputeRandomness(long long count);
+		long long GetPoolSize() const;
+		void Answer(const std::vector<EncryptedQuery> &queries, std::vector<std::vector<unsigned char> > &responses);
+	};
+
+} //namespace sbf
+
+#endif /* ENCRYPTED_H */
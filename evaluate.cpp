@@ -0,0 +1,377 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define SBF_DLL
+
+#include "evaluate.h"
+#include "dataset.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <stdexcept>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// Per-thread counters, merged into the report once the threads are joined
+struct Tally
+{
+    long long count;
+    long long errors;
+    std::vector<long long> AREA_count;
+    std::vector<long long> AREA_errors;
+
+    Tally(int AREA_number) : count(0), errors(0), AREA_count(AREA_number + 1, 0), AREA_errors(AREA_number + 1, 0) {}
+};
+
+
+// Moves the start of a byte range of the block to the beginning of the first
+// line starting within the range, so that each line belongs to exactly one
+// thread
+size_t LineStart(const std::string &block, size_t pos)
+{
+    if (pos == 0) return 0;
+    const char *eol = (const char *)memchr(block.data() + pos - 1, '\n', block.size() - (pos - 1));
+    return (eol == NULL) ? block.size() : (size_t)(eol + 1 - block.data());
+}
+
+} //namespace
+
+
+/* ***************************** REPORT METHODS ***************************** */
+
+
+EvaluationReport::EvaluationReport(int AREA_number)
+{
+    this->AREA_number = AREA_number;
+    this->members = 0;
+    this->well_recognised = 0;
+    this->iser = 0;
+    this->AREA_members.assign(AREA_number + 1, 0);
+    this->AREA_iser.assign(AREA_number + 1, 0);
+    this->AREA_written.assign(AREA_number + 1, 0);
+    this->AREA_emerged.assign(AREA_number + 1, 0);
+    this->non_members = 0;
+    this->true_negatives = 0;
+    this->false_positives = 0;
+    this->AREA_fp.assign(AREA_number + 1, 0);
+}
+
+
+// Returns the inter-set errors rate of the self-check
+float EvaluationReport::GetIserRate() const
+{
+    return (float)this->iser / (float)this->members;
+}
+
+
+// Returns the false positives rate of the verification
+float EvaluationReport::GetFpRate() const
+{
+    return (float)this->false_positives / (float)this->non_members;
+}
+
+
+// Returns the exact emersion of an area, as computed by the self-check from
+// an insertion record (-1 if not computed)
+float EvaluationReport::GetAreaEmersion(const int area) const
+{
+    if (this->AREA_written[area] == 0) return -1;
+    return (float)this->AREA_emerged[area] / (float)this->AREA_written[area];
+}
+
+
+// Writes the per-area inter-set errors onto a CSV file (path)
+// (CSV: area;errors;rate)
+void EvaluationReport::SaveIseToDisk(const std::string path) const
+{
+    std::ofstream rate_file;
+
+    rate_file.open(path.c_str());
+    rate_file.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    rate_file.precision(5);
+
+    rate_file << "area" << ";" << "errors" << ";" << "rate" << std::endl;
+    for (int j = 1; j < this->AREA_number + 1; j++) {
+        rate_file << j << ";" << this->AREA_iser[j] << ";" << (float)this->AREA_iser[j] / (float)this->AREA_members[j] << std::endl;
+    }
+
+    rate_file.close();
+}
+
+
+// Writes the per-area false positives onto a CSV file (path)
+// (CSV: area;false positives;rate)
+void EvaluationReport::SaveFpToDisk(const std::string path) const
+{
+    std::ofstream rate_file;
+
+    rate_file.open(path.c_str());
+    rate_file.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    rate_file.precision(5);
+
+    rate_file << "area" << ";" << "false positives" << ";" << "rate" << std::endl;
+    for (int j = 1; j < this->AREA_number + 1; j++) {
+        rate_file << j << ";" << this->AREA_fp[j] << ";" << (float)this->AREA_fp[j] / (float)this->non_members << std::endl;
+    }
+
+    rate_file.close();
+}
+
+
+/* **************************** PRIVATE METHODS **************************** */
+
+
+// Checks every element of the stream, one block at a time, splitting each
+// block across the threads.
+// labelled: true    lines are "area,element" (self-check)
+// labelled: false   lines are non-member elements (verification)
+void Evaluator::Run(std::istream &in, bool labelled)
+{
+    const int AREA_number = this->report.AREA_number;
+    const int threads = ThreadCount(this->threads);
+    std::vector<Tally> tallies(threads, Tally(AREA_number));
+    std::string carry, block;
+
+    while (ReadBlock(in, Evaluator::BLOCK_SIZE, carry, block)) {
+        ParallelFor(threads, (long long)block.size(), [&](int t, long long begin, long long end) {
+            Tally &tally = tallies[t];
+            size_t b = LineStart(block, (size_t)begin);
+            size_t e = LineStart(block, (size_t)end);
+            if (b >= e) return;
+
+            ForEachLine(block.data() + b, block.data() + e, [&](const char *line, size_t length) {
+                // Comments (e.g. the "#sbf" header) only exist in labelled
+                // datasets: non-members may start with '#'
+                if (labelled && line[0] == '#') return;
+                const char *element = line;
+                int element_length = (int)length;
+                int area = labelled ? ParseLine(line, length, this->delimiter, element, element_length) : 0;
+                int area_check = this->filter->Check(element, element_length);
+                bool in_range = (area >= 0 && area <= AREA_number);
+
+                tally.count++;
+                if (in_range) tally.AREA_count[area]++;
+                if (area != area_check) {
+                    tally.errors++;
+                    // Self-check errors are tallied on the actual area,
+                    // false positives on the returned one
+                    if (!labelled) tally.AREA_errors[area_check]++;
+                    else if (in_range) tally.AREA_errors[area]++;
+                }
+            });
+        });
+    }
+
+    for (int t = 0; t < threads; t++) {
+        if (labelled) {
+            this->report.members += tallies[t].count;
+            this->report.iser += tallies[t].errors;
+            this->report.well_recognised += tallies[t].count - tallies[t].errors;
+        }
+        else {
+            this->report.non_members += tallies[t].count;
+            this->report.false_positives += tallies[t].errors;
+            this->report.true_negatives += tallies[t].count - tallies[t].errors;
+        }
+        for (int a = 0; a <= AREA_number; a++) {
+            if (labelled) {
+                this->report.AREA_members[a] += tallies[t].AREA_count[a];
+                this->report.AREA_iser[a] += tallies[t].AREA_errors[a];
+            }
+            else this->report.AREA_fp[a] += tallies[t].AREA_errors[a];
+        }
+    }
+}
+
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+Evaluator::Evaluator(const SBF *filter, int threads, char delimiter) : report(filter->GetAreaNumber())
+{
+    this->filter = filter;
+    this->threads = threads;
+    this->delimiter = delimiter;
+}
+
+
+// Checks every element of the labelled dataset at path against its area
+void Evaluator::SelfCheck(const std::string &path)
+{
+    std::ifstream myfile(path.c_str(), std::ios::binary);
+    if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+    this->Run(myfile, true);
+}
+
+
+// Checks every element of the labelled dataset read from the stream
+void Evaluator::SelfCheck(std::istream &in)
+{
+    this->Run(in, true);
+}
+
+
+// Checks n elements given their area labels and their digests (HASH_number
+// per element, as buffered by Ingest), without hashing them again
+void Evaluator::SelfCheck(const int *areas, const unsigned int *digests, long long n)
+{
+    const int AREA_number = this->report.AREA_number;
+    const int k = this->filter->GetHashNumber();
+    const int threads = ThreadCount(this->threads);
+    std::vector<Tally> tallies(threads, Tally(AREA_number));
+
+    ParallelFor(threads, n, [&](int t, long long begin, long long end) {
+        Tally &tally = tallies[t];
+        for (long long i = begin; i < end; i++) {
+            int area = areas[i];
+            bool in_range = (area >= 0 && area <= AREA_number);
+
+            tally.count++;
+            if (in_range) tally.AREA_count[area]++;
+            if (area != this->filter->CheckDigests(digests + (size_t)i * k)) {
+                tally.errors++;
+                if (in_range) tally.AREA_errors[area]++;
+            }
+        }
+    });
+
+    for (int t = 0; t < threads; t++) {
+        this->report.members += tallies[t].count;
+        this->report.iser += tallies[t].errors;
+        this->report.well_recognised += tallies[t].count - tallies[t].errors;
+        for (int a = 0; a <= AREA_number; a++) {
+            this->report.AREA_members[a] += tallies[t].AREA_count[a];
+            this->report.AREA_iser[a] += tallies[t].AREA_errors[a];
+        }
+    }
+}
+
+
+// Checks the elements recorded while building the filter (see
+// SBF::EnableRecorder) from their recorded cell indices, without hashing
+// them again. Also computes the exact emersion of each area: the distinct
+// cells written by its elements are collected area by area, in parallel,
+// and compared with the final filter.
+void Evaluator::SelfCheck(const InsertionRecorder &recorder)
+{
+    const int AREA_number = this->report.AREA_number;
+    const int k = this->filter->GetHashNumber();
+    const int threads = ThreadCount(this->threads);
+    const int runs = recorder.GetRuns();
+    if (recorder.GetHashNumber() != k) throw std::invalid_argument("The record does not match the filter.");
+
+    std::vector<long long> starts(runs + 1, recorder.GetMembers());
+    std::vector<std::vector<int> > AREA_runs(AREA_number + 1);
+    for (int r = 0; r < runs; r++) {
+        int area = recorder.GetRunArea(r);
+        starts[r] = recorder.GetRunStart(r);
+        if (area >= 0 && area <= AREA_number) AREA_runs[area].push_back(r);
+    }
+
+    std::vector<Tally> tallies(threads, Tally(AREA_number));
+    ParallelFor(threads, recorder.GetMembers(), [&](int t, long long begin, long long end) {
+        Tally &tally = tallies[t];
+        std::vector<unsigned int> indices(k);
+        int run = (int)(std::upper_bound(starts.begin(), starts.end() - 1, begin) - starts.begin()) - 1;
+        for (long long i = begin; i < end; i++) {
+            while (i >= starts[run + 1]) run++;
+            int area = recorder.GetRunArea(run);
+            bool in_range = (area >= 0 && area <= AREA_number);
+
+            recorder.GetIndices(i, indices.data());
+            tally.count++;
+            if (in_range) tally.AREA_count[area]++;
+            if (area != this->filter->CheckIndices(indices.data())) {
+                tally.errors++;
+                if (in_range) tally.AREA_errors[area]++;
+            }
+        }
+    });
+
+    for (int t = 0; t < threads; t++) {
+        this->report.members += tallies[t].count;
+        this->report.iser += tallies[t].errors;
+        this->report.well_recognised += tallies[t].count - tallies[t].errors;
+        for (int a = 0; a <= AREA_number; a++) {
+            this->report.AREA_members[a] += tallies[t].AREA_count[a];
+            this->report.AREA_iser[a] += tallies[t].AREA_errors[a];
+        }
+    }
+
+    // Areas differ in size, so the threads take them one at a time
+    std::atomic<int> next(1);
+    ParallelFor(threads, threads, [&](int, long long, long long) {
+        std::vector<unsigned int> cells;
+        for (int a = next++; a <= AREA_number; a = next++) {
+            cells.clear();
+            for (size_t r = 0; r < AREA_runs[a].size(); r++) {
+                int run = AREA_runs[a][r];
+                for (long long i = starts[run]; i < starts[run + 1]; i++) {
+                    cells.resize(cells.size() + k);
+                    recorder.GetIndices(i, &cells[cells.size() - k]);
+                }
+            }
+            std::sort(cells.begin(), cells.end());
+            cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+            long long emerged = 0;
+            for (size_t c = 0; c < cells.size(); c++) {
+                int label;
+                this->filter->ReadCells(cells[c], 1, &label);
+                if (label == a) emerged++;
+            }
+            this->report.AREA_written[a] += (long long)cells.size();
+            this->report.AREA_emerged[a] += emerged;
+        }
+    });
+}
+
+
+// Checks every element of the unlabelled (non-members) dataset at path
+void Evaluator::Verify(const std::string &path)
+{
+    std::ifstream myfile(path.c_str(), std::ios::binary);
+    if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+    this->Run(myfile, false);
+}
+
+
+// Checks every element of the unlabelled dataset read from the stream
+void Evaluator::Verify(std::istream &in)
+{
+    this->Run(in, false);
+}
+
+
+// Returns the accumulated evaluation report
+const EvaluationReport &Evaluator::GetReport() const
+{
+    return this->report;
+}
+
+} //namespace sbf
@@ -0,0 +1,111 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef EVALUATE_H
+#define EVALUATE_H
+
+#include "sbf.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+
+namespace sbf {
+
+	// Results of the evaluation of a filter over a labelled dataset
+	// ("area,element" lines, the self-check) and over an unlabelled dataset
+	// of non-members (one element per line, the verification)
+	struct DLL_PUBLIC EvaluationReport
+	{
+		int AREA_number;
+		// Self-check: checked elements, elements assigned to the correct set,
+		// inter-set errors, and their per-area breakdown
+		long long members;
+		long long well_recognised;
+		long long iser;
+		std::vector<long long> AREA_members;
+		std::vector<long long> AREA_iser;
+		// Self-check from an insertion record: distinct cells written by each
+		// area, and how many of them still hold its label
+		std::vector<long long> AREA_written;
+		std::vector<long long> AREA_emerged;
+		// Verification: checked elements, true negatives, false positives,
+		// and false positives per (wrongly) returned area
+		long long non_members;
+		long long true_negatives;
+		long long false_positives;
+		std::vector<long long> AREA_fp;
+
+		EvaluationReport(int AREA_number = 0);
+
+		float GetIserRate() const;
+		float GetFpRate() const;
+		float GetAreaEmersion(const int area) const;
+		void SaveIseToDisk(const std::string path) const;
+		void SaveFpToDisk(const std::string path) const;
+	};
+
+
+	// Evaluates a constructed filter by checking labelled and unlabelled
+	// datasets. The elements are split across threads, each keeping its own
+	// per-area error tallies, which are merged into the report at the end of
+	// each run. Multiple runs accumulate into the same report.
+	class DLL_PUBLIC Evaluator
+	{
+
+	private:
+		const SBF *filter;
+		int threads;
+		char delimiter;
+		EvaluationReport report;
+
+		// Private methods (commented in the evaluate.cpp)
+		void Run(std::istream &in, bool labelled);
+
+
+	public:
+		// The size in bytes of the dataset blocks checked in parallel
+		const static int BLOCK_SIZE = 1 << 24;
+
+		// Evaluator constructor
+		// Arguments:
+		// filter       the filter to be evaluated (not owned)
+		// threads      number of threads (0 uses the available hardware threads)
+		// delimiter    delimiter between area label and element in labelled
+		//              datasets
+		Evaluator(const SBF *filter, int threads, char delimiter = ',');
+
+		// Public methods (commented in the evaluate.cpp)
+		void SelfCheck(const std::string &path);
+		void SelfCheck(std::istream &in);
+		void SelfCheck(const int *areas, const unsigned int *digests, long long n);
+		void SelfCheck(const InsertionRecorder &recorder);
+		void Verify(const std::string &path);
+		void Verify(std::istream &in);
+		const EvaluationReport &GetReport() const;
+	};
+
+} //namespace sbf
+
+#endif /* EVALUATE_H */
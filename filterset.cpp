@@ -0,0 +1,433 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define SBF_DLL
+
+#include "filterset.h"
+#include "parallel.h"
+
+#include <stdexcept>
+#include <string.h>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// Returns the label of a cell (2-byte cells are big-endian, as in SBF)
+inline int GetLabel(const BYTE *cells, int cell_size, unsigned int index)
+{
+    if (cell_size == 1) return (int)cells[index];
+    return (int)((cells[2 * index] << 8) | cells[2 * index + 1]);
+}
+
+
+// Writes the label of a cell
+inline void SetLabel(BYTE *cells, int cell_size, unsigned int index, int area)
+{
+    if (cell_size == 1) cells[index] = (BYTE)area;
+    else {
+        cells[2 * index] = (BYTE)(area >> 8);
+        cells[2 * index + 1] = (BYTE)area;
+    }
+}
+
+
+// Validates the size of an element, which must fit the hash salts (as the
+// batch methods of SBF do)
+inline void CheckSize(int size)
+{
+    if (size < 0 || size > SBF::MAX_INPUT_SIZE) throw std::invalid_argument("Invalid element size.");
+}
+
+} //namespace
+
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+FilterSet::FilterSet(int threads)
+{
+    this->threads = threads;
+    this->live = 0;
+    this->arena = -1;
+}
+
+
+FilterSet::~FilterSet()
+{
+    for (size_t h = 0; h < this->hashers.size(); h++) delete this->hashers[h].salts;
+    for (size_t b = 0; b < this->blocks.size(); b++) {
+        FreeCells(this->blocks[b].cells, this->blocks[b].size, this->blocks[b].mapped);
+    }
+}
+
+
+// Adds an empty filter, with the same arguments as the SBF constructor, and
+// returns its tenant number. Filters with the same HASH_family,
+// HASH_number and salt_path share their salts (the salt file is read, or
+// created, by the first of them).
+int FilterSet::AddFilter(int bit_mapping, int HASH_family, int HASH_number, int AREA_number, const std::string &salt_path)
+{
+    if (bit_mapping <= 0 || bit_mapping > SBF::MAX_BIT_MAPPING) throw std::invalid_argument("Invalid bit mapping.");
+    if (AREA_number <= 0 || AREA_number > SBF::MAX_AREA_NUMBER) throw std::invalid_argument("Invalid number of areas.");
+    if (HASH_number <= 0 || HASH_number > SBF::MAX_HASH_NUMBER) throw std::invalid_argument("Invalid number of hash runs.");
+    if (salt_path.length() == 0) throw std::invalid_argument("Invalid hash salt path.");
+
+    int hasher = -1;
+    for (size_t h = 0; h < this->hashers.size(); h++) {
+        const Hasher &candidate = this->hashers[h];
+        if (candidate.salts != NULL && candidate.HASH_family == HASH_family && candidate.HASH_number == HASH_number && candidate.salt_path == salt_path) {
+            hasher = (int)h;
+            break;
+        }
+    }
+    if (hasher < 0) {
+        Hasher created;
+        created.salts = new HashSalt(HASH_family, HASH_number, salt_path);
+        created.HASH_family = HASH_family;
+        created.HASH_number = HASH_number;
+        created.salt_path = salt_path;
+        created.filters = 0;
+
+        // Slots of released hashers are reused
+        for (size_t h = 0; h < this->hashers.size() && hasher < 0; h++) {
+            if (this->hashers[h].salts == NULL) hasher = (int)h;
+        }
+        if (hasher < 0) {
+            if (this->hashers.size() >= 32767) {
+                delete created.salts;
+                throw std::runtime_error("Too many hash configurations.");
+            }
+            hasher = (int)this->hashers.size();
+            this->hashers.push_back(created);
+        }
+        else this->hashers[hasher] = created;
+    }
+
+    Filter filter;
+    filter.cell_size = (AREA_number <= 255) ? 1 : 2;
+    filter.bit_mapping = (unsigned char)bit_mapping;
+    filter.AREA_number = AREA_number;
+    filter.members = 0;
+    filter.hasher = (short)hasher;
+    filter.cells = this->Allocate((size_t)filter.cell_size << bit_mapping);
+
+    this->hashers[hasher].filters++;
+    this->filters.push_back(filter);
+    this->live++;
+    return (int)this->filters.size() - 1;
+}
+
+
+// Removes a filter: its cells are kept for a later filter of the same size,
+// and its salts are released with the last filter using them. Tenant
+// numbers are not reused.
+void FilterSet::RemoveFilter(int tenant)
+{
+    this->GetFilter(tenant);
+    Filter &filter = this->filters[tenant];
+    Hasher &hasher = this->hashers[filter.hasher];
+
+    this->released[(size_t)filter.cell_size << filter.bit_mapping].push_back(filter.cells);
+    if (--hasher.filters == 0) {
+        delete hasher.salts;
+        hasher.salts = NULL;
+    }
+
+    filter.cells = NULL;
+    filter.hasher = -1;
+    this->live--;
+}
+
+
+// Maps an element into a tenant's filter (see SBF::Insert; the elements of
+// a filter must be inserted in ascending order of area label)
+void FilterSet::Insert(int tenant, const char *string, const int size, const int area)
+{
+    this->GetFilter(tenant);
+    Filter &filter = this->filters[tenant];
+    if (area <= 0 || area > filter.AREA_number) throw std::invalid_argument("Invalid area label.");
+    CheckSize(size);
+
+    std::vector<unsigned int> digests(this->hashers[filter.hasher].HASH_number);
+    this->hashers[filter.hasher].salts->Digest(string, size, digests.data());
+    this->InsertDigests(filter, digests.data(), area);
+}
+
+
+// Verifies an element against a tenant's filter (see SBF::Check)
+int FilterSet::Check(int tenant, const char *string, const int size) const
+{
+    const Filter &filter = this->GetFilter(tenant);
+    CheckSize(size);
+
+    std::vector<unsigned int> digests(this->hashers[filter.hasher].HASH_number);
+    this->hashers[filter.hasher].salts->Digest(string, size, digests.data());
+    return this->CheckDigests(filter, digests.data());
+}
+
+
+// Inserts count elements, each into its tenant's filter. The elements are
+// hashed in parallel batches; each thread then inserts the elements of its
+// own tenants, in their original order. All the elements are validated
+// first, so that nothing is inserted if one of them is invalid (e.g. longer
+// than SBF::MAX_INPUT_SIZE).
+void FilterSet::Insert(const TenantElement *elements, const long long count)
+{
+    for (long long i = 0; i < count; i++) {
+        const Filter &filter = this->GetFilter(elements[i].tenant);
+        if (elements[i].area <= 0 || elements[i].area > filter.AREA_number) throw std::invalid_argument("Invalid area label.");
+        CheckSize(elements[i].size);
+    }
+
+    std::vector<long long> offsets(FilterSet::BATCH_ELEMENTS + 1);
+    std::vector<unsigned int> digests;
+
+    for (long long base = 0; base < count; base += FilterSet::BATCH_ELEMENTS) {
+        long long batch = (count - base < FilterSet::BATCH_ELEMENTS) ? count - base : FilterSet::BATCH_ELEMENTS;
+
+        // The number of digests depends on the tenant's hash configuration
+        offsets[0] = 0;
+        for (long long i = 0; i < batch; i++) {
+            const Filter &filter = this->filters[elements[base + i].tenant];
+            offsets[i + 1] = offsets[i] + this->hashers[filter.hasher].HASH_number;
+        }
+        if (digests.size() < (size_t)offsets[batch]) digests.resize((size_t)offsets[batch]);
+
+        ParallelFor(this->threads, batch, [&](int, long long begin, long long end) {
+            for (long long i = begin; i < end; i++) {
+                const TenantElement &e = elements[base + i];
+                this->hashers[this->filters[e.tenant].hasher].salts->Digest(e.element, e.size, &digests[(size_t)offsets[i]]);
+            }
+        });
+
+        // Each part owns the tenants whose residue modulo parts falls in
+        // its range, so that all of them are inserted however many parts
+        // the executor actually runs
+        const int parts = ThreadCount(this->threads);
+        ParallelFor(parts, parts, [&](int, long long first, long long last) {
+            for (long long i = 0; i < batch; i++) {
+                const TenantElement &e = elements[base + i];
+                int residue = e.tenant % parts;
+                if (residue < first || residue >= last) continue;
+                this->InsertDigests(this->filters[e.tenant], &digests[(size_t)offsets[i]], e.area);
+            }
+        });
+    }
+}
+
+
+// Checks count elements, each against its tenant's filter, writing the
+// results into areas. Throws std::invalid_argument if an element is longer
+// than SBF::MAX_INPUT_SIZE.
+void FilterSet::Check(const TenantElement *elements, const long long count, int *areas) const
+{
+    for (long long i = 0; i < count; i++) {
+        this->GetFilter(elements[i].tenant);
+        CheckSize(elements[i].size);
+    }
+
+    ParallelFor(this->threads, count, [&](int, long long begin, long long end) {
+        std::vector<unsigned int> digests;
+        for (long long i = begin; i < end; i++) {
+            const Filter &filter = this->filters[elements[i].tenant];
+            const Hasher &hasher = this->hashers[filter.hasher];
+            digests.resize(hasher.HASH_number);
+            hasher.salts->Digest(elements[i].element, elements[i].size, digests.data());
+            areas[i] = this->CheckDigests(filter, digests.data());
+        }
+    });
+}
+
+
+// Copies the area labels of count cells of a tenant's filter, starting from
+// the cell at index first, into areas
+void FilterSet::ReadCells(int tenant, const unsigned int first, const int count, int *areas) const
+{
+    const Filter &filter = this->GetFilter(tenant);
+    if (count < 0 || (unsigned long long)first + count > (1ULL << filter.bit_mapping)) throw std::out_of_range("Invalid cell range.");
+
+    for (int i = 0; i < count; i++) areas[i] = GetLabel(filter.cells, filter.cell_size, first + i);
+}
+
+
+// Returns the number of filters in the set (removed ones excluded)
+int FilterSet::GetFilters() const
+{
+    return this->live;
+}
+
+
+// Returns the number of distinct hash configurations (salt sets) in use
+int FilterSet::GetHashers() const
+{
+    int count = 0;
+    for (size_t h = 0; h < this->hashers.size(); h++) {
+        if (this->hashers[h].salts != NULL) count++;
+    }
+    return count;
+}
+
+
+// Returns the bit_mapping of a tenant's filter
+int FilterSet::GetBitMapping(int tenant) const
+{
+    return this->GetFilter(tenant).bit_mapping;
+}
+
+
+// Returns the number of digests per element of a tenant's filter
+int FilterSet::GetHashNumber(int tenant) const
+{
+    return this->hashers[this->GetFilter(tenant).hasher].HASH_number;
+}
+
+
+// Returns the number of areas of a tenant's filter
+int FilterSet::GetAreaNumber(int tenant) const
+{
+    return this->GetFilter(tenant).AREA_number;
+}
+
+
+// Returns the number of elements inserted into a tenant's filter
+int FilterSet::GetMembers(int tenant) const
+{
+    return this->GetFilter(tenant).members;
+}
+
+
+// Returns the memory footprint of the set (see memusage.h): object holds the
+// container and the filter headers, cells the cell arrays of the live
+// filters, cells_mapped and cells_resident the arena blocks, salts the
+// shared salts
+MemoryUsage FilterSet::GetMemoryUsage() const
+{
+    MemoryUsage usage;
+
+    usage.object = sizeof(FilterSet) + this->filters.capacity() * sizeof(Filter) + this->hashers.capacity() * sizeof(Hasher);
+    for (size_t i = 0; i < this->filters.size(); i++) {
+        if (this->filters[i].hasher >= 0) usage.cells += (size_t)this->filters[i].cell_size << this->filters[i].bit_mapping;
+    }
+    for (size_t b = 0; b < this->blocks.size(); b++) {
+        usage.cells_mapped += MappedBytes(this->blocks[b].size, this->blocks[b].mapped);
+        usage.cells_resident += ResidentBytes(this->blocks[b].cells, this->blocks[b].size, this->blocks[b].mapped);
+    }
+    for (size_t h = 0; h < this->hashers.size(); h++) {
+        if (this->hashers[h].salts != NULL) usage.salts += this->hashers[h].salts->GetBytes();
+    }
+    usage.scratch = (size_t)SBF::MAX_INPUT_SIZE + 64;
+    usage.filters = this->live;
+
+    return usage;
+}
+
+
+/* **************************** PRIVATE METHODS **************************** */
+
+
+// Returns a zeroed cell array of the given size (a power of two): a released
+// one of the same size, or a new one from the current arena block. Arrays
+// are aligned to their size, up to a cache line.
+BYTE *FilterSet::Allocate(size_t bytes)
+{
+    std::map<size_t, std::vector<BYTE*> >::iterator it = this->released.find(bytes);
+    if (it != this->released.end() && !it->second.empty()) {
+        BYTE *cells = it->second.back();
+        it->second.pop_back();
+        memset(cells, 0, bytes);
+        return cells;
+    }
+
+    if (bytes > FilterSet::ARENA_BLOCK / 4) {
+        Block block;
+        block.size = bytes;
+        block.used = bytes;
+        block.cells = AllocateCells(bytes, block.mapped);
+        this->blocks.push_back(block);
+        return block.cells;
+    }
+
+    const size_t alignment = (bytes < 64) ? bytes : 64;
+    if (this->arena >= 0) {
+        Block &block = this->blocks[this->arena];
+        size_t start = (block.used + alignment - 1) / alignment * alignment;
+        if (start + bytes <= block.size) {
+            block.used = start + bytes;
+            return block.cells + start;
+        }
+    }
+
+    // The current arena block is full (its tail is left unused)
+    Block block;
+    block.size = FilterSet::ARENA_BLOCK;
+    block.used = bytes;
+    block.cells = AllocateCells(block.size, block.mapped);
+    this->blocks.push_back(block);
+    this->arena = (int)this->blocks.size() - 1;
+    return block.cells;
+}
+
+
+// Returns the header of a live filter
+const FilterSet::Filter &FilterSet::GetFilter(int tenant) const
+{
+    if (tenant < 0 || tenant >= (int)this->filters.size() || this->filters[tenant].hasher < 0) {
+        throw std::out_of_range("Invalid tenant.");
+    }
+    return this->filters[tenant];
+}
+
+
+// Maps an element given its digests (as SBF::InsertDigests)
+void FilterSet::InsertDigests(Filter &filter, const unsigned int *digests, int area)
+{
+    const int HASH_number = this->hashers[filter.hasher].HASH_number;
+    const int shift = SBF::MAX_BIT_MAPPING - filter.bit_mapping;
+
+    for (int k = 0; k < HASH_number; k++) {
+        unsigned int index = digests[k] >> shift;
+        if (GetLabel(filter.cells, filter.cell_size, index) < area) SetLabel(filter.cells, filter.cell_size, index, area);
+    }
+    filter.members++;
+}
+
+
+// Verifies an element given its digests (as SBF::CheckDigests)
+int FilterSet::CheckDigests(const Filter &filter, const unsigned int *digests) const
+{
+    const int HASH_number = this->hashers[filter.hasher].HASH_number;
+    const int shift = SBF::MAX_BIT_MAPPING - filter.bit_mapping;
+    int area = 0;
+
+    for (int k = 0; k < HASH_number; k++) {
+        int current_area = GetLabel(filter.cells, filter.cell_size, digests[k] >> shift);
+        if (current_area == 0) return 0;
+        if (area == 0 || current_area < area) area = current_area;
+    }
+    return area;
+}
+
+} //namespace sbf
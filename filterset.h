@@ -0,0 +1,137 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#ifndef FILTERSET_H
+#define FILTERSET_H
+
+#include "sbf.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace sbf {
+
+	// An element of a bulk FilterSet operation, addressed to a tenant's
+	// filter (the area is only used by insertions)
+	struct DLL_PUBLIC TenantElement
+	{
+		int tenant;
+		int area;
+		const char *element;
+		int size;
+	};
+
+
+	// Many small filters (e.g. one per tenant) in one container. The cell
+	// arrays are carved out of large arena blocks, and the hash salts are
+	// loaded once per hash configuration (family, number of digests and salt
+	// file) and shared by reference count among the filters using it, so a
+	// filter only takes its cells plus a small fixed header: the per-area
+	// statistics of the SBF class are not kept. Cell indices and labels are
+	// the same as those of an SBF with the same parameters and salts.
+	// Insert and Check on different tenants may run concurrently; the bulk
+	// methods are parallelized internally (insertions are split by tenant,
+	// so that the elements of each tenant are still inserted in order).
+	class DLL_PUBLIC FilterSet
+	{
+
+	private:
+		// Per-filter header (hasher is -1 once the filter is removed)
+		struct Filter
+		{
+			BYTE *cells;
+			int members;
+			short hasher;
+			unsigned char bit_mapping;
+			unsigned char cell_size;
+			int AREA_number;
+		};
+
+		// Shared hash configuration (salts is NULL once no filter uses it)
+		struct Hasher
+		{
+			HashSalt *salts;
+			int HASH_family;
+			int HASH_number;
+			std::string salt_path;
+			int filters;
+		};
+
+		struct Block
+		{
+			BYTE *cells;
+			size_t size;
+			size_t used;
+			int mapped;
+		};
+
+		int threads;
+		std::vector<Filter> filters;
+		std::vector<Hasher> hashers;
+		std::vector<Block> blocks;
+		std::map<size_t, std::vector<BYTE*> > released;
+		int arena;
+		int live;
+
+		// Private methods (commented in the filterset.cpp)
+		BYTE *Allocate(size_t bytes);
+		const Filter &GetFilter(int tenant) const;
+		void InsertDigests(Filter &filter, const unsigned int *digests, int area);
+		int CheckDigests(const Filter &filter, const unsigned int *digests) const;
+
+		FilterSet(const FilterSet&);
+		FilterSet& operator=(const FilterSet&);
+
+	public:
+		// Size in bytes of the arena blocks (larger filters get a block of
+		// their own)
+		const static size_t ARENA_BLOCK = 1 << 24;
+		// Number of elements hashed per parallel batch by the bulk Insert
+		const static int BATCH_ELEMENTS = 1 << 16;
+
+		FilterSet(int threads);
+		~FilterSet();
+
+		// Public methods (commented in the filterset.cpp)
+		int AddFilter(int bit_mapping, int HASH_family, int HASH_number, int AREA_number, const std::string &salt_path);
+		void RemoveFilter(int tenant);
+		void Insert(int tenant, const char *string, const int size, const int area);
+		int Check(int tenant, const char *string, const int size) const;
+		void Insert(const TenantElement *elements, const long long count);
+		void Check(const TenantElement *elements, const long long count, int *areas) const;
+		void ReadCells(int tenant, const unsigned int first, const int count, int *areas) const;
+		int GetFilters() const;
+		int GetHashers() const;
+		int GetBitMapping(int tenant) const;
+		int GetHashNumber(int tenant) const;
+		int GetAreaNumber(int tenant) const;
+		int GetMembers(int tenant) const;
+		MemoryUsage GetMemoryUsage() const;
+	};
+
+} //namespace sbf
+
+#endif /* FILTERSET_H */
@@ -0,0 +1,334 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sbflib.h>
+#include <parallel.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+//This program generates synthetic datasets in the format of the libSBF test
+//datasets, so that tests and benchmarks can run offline at any scale:
+//- a construction dataset, with one "area,element" pair per line, in
+//  ascending order of area labels;
+//- a verification dataset, with one non-member element per line.
+//The output only depends on the settings and the seed (not on the number of
+//threads). Every element is unique: it embeds its index (in base 62) after
+//a random prefix which pads it to the drawn length.
+//
+//The binary format stores, after an 8-byte magic ("SBFDATA1"), the number of
+//records (uint64), the number of areas (uint32, 0 for verification
+//datasets) and then one record per element: the area label (uint16, only for
+//construction datasets), the element length (uint8) and the element bytes.
+//All integers are little endian.
+
+
+//generator settings, as read from the command line
+struct Settings {
+	long long elements;
+	long long non_elements;
+	int areas;
+	std::string distribution;
+	double zipf_s;
+	double geometric_p;
+	std::string length;
+	int min_length;
+	int max_length;
+	unsigned long long seed;
+	std::string format;
+	int threads;
+	bool header;
+	std::string members_file;
+	std::string non_members_file;
+};
+
+
+//elements are generated in chunks of this size, each one by a single thread
+const long long CHUNK = 1 << 18;
+
+const char ALPHABET[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+//M_PI is not defined by every compiler (e.g. MSVC, without _USE_MATH_DEFINES)
+const double PI = 3.14159265358979323846;
+
+
+void Usage() {
+	std::cerr << "Usage: gen-app [options]" << std::endl;
+	std::cerr << "  --elements N            number of elements in the construction dataset (default: 10000)" << std::endl;
+	std::cerr << "  --areas N               number of areas, at most 65535 (default: 10)" << std::endl;
+	std::cerr << "  --distribution D        area sizes: uniform, zipf or geometric (default: uniform)" << std::endl;
+	std::cerr << "  --zipf-s S              exponent of the zipf distribution (default: 1)" << std::endl;
+	std::cerr << "  --geometric-p P         ratio between consecutive area sizes is 1-P (default: 0.1)" << std::endl;
+	std::cerr << "  --non-elements N        number of elements in the verification dataset (default: 0)" << std::endl;
+	std::cerr << "  --length L              element lengths: fixed, uniform or normal (default: uniform)" << std::endl;
+	std::cerr << "  --min-length N          minimum element length (default: 8)" << std::endl;
+	std::cerr << "  --max-length N          maximum element length, at most 128 (default: 24)" << std::endl;
+	std::cerr << "  --seed N                random seed (default: 1)" << std::endl;
+	std::cerr << "  --format F              text or binary (default: text)" << std::endl;
+	std::cerr << "  --threads N             generator threads, 0 for all hardware threads (default: 0)" << std::endl;
+	std::cerr << "  --header                writes a \"#sbf members=N areas=M\" header line (text only)" << std::endl;
+	std::cerr << "  --members-file FILE     construction dataset (default: area-element.csv)" << std::endl;
+	std::cerr << "  --non-members-file FILE verification dataset (default: non-elements.csv)" << std::endl;
+}
+
+
+//parses the command line flags; returns false on invalid input
+bool ParseArguments(int argc, char** argv, Settings& s) {
+	s.elements = 10000;
+	s.non_elements = 0;
+	s.areas = 10;
+	s.distribution = "uniform";
+	s.zipf_s = 1;
+	s.geometric_p = 0.1;
+	s.length = "uniform";
+	s.min_length = 8;
+	s.max_length = 24;
+	s.seed = 1;
+	s.format = "text";
+	s.threads = 0;
+	s.header = false;
+	s.members_file = "area-element.csv";
+	s.non_members_file = "non-elements.csv";
+
+	for (int i = 1; i < argc; i++) {
+		std::string flag(argv[i]);
+		if (flag == "--header") {
+			s.header = true;
+			continue;
+		}
+		if (i + 1 >= argc) return false;
+		std::string value(argv[++i]);
+
+		if (flag == "--elements") s.elements = atoll(value.c_str());
+		else if (flag == "--areas") s.areas = atoi(value.c_str());
+		else if (flag == "--distribution") s.distribution = value;
+		else if (flag == "--zipf-s") s.zipf_s = atof(value.c_str());
+		else if (flag == "--geometric-p") s.geometric_p = atof(value.c_str());
+		else if (flag == "--non-elements") s.non_elements = atoll(value.c_str());
+		else if (flag == "--length") s.length = value;
+		else if (flag == "--min-length") s.min_length = atoi(value.c_str());
+		else if (flag == "--max-length") s.max_length = atoi(value.c_str());
+		else if (flag == "--seed") s.seed = strtoull(value.c_str(), NULL, 10);
+		else if (flag == "--format") s.format = value;
+		else if (flag == "--threads") s.threads = atoi(value.c_str());
+		else if (flag == "--members-file") s.members_file = value;
+		else if (flag == "--non-members-file") s.non_members_file = value;
+		else return false;
+	}
+
+	if (s.elements < 0 || s.non_elements < 0) return false;
+	if (s.areas <= 0 || s.areas > sbf::SBF::MAX_AREA_NUMBER) return false;
+	if (s.distribution != "uniform" && s.distribution != "zipf" && s.distribution != "geometric") return false;
+	if (s.geometric_p <= 0 || s.geometric_p >= 1) return false;
+	if (s.length != "fixed" && s.length != "uniform" && s.length != "normal") return false;
+	if (s.min_length <= 0 || s.max_length > sbf::SBF::MAX_INPUT_SIZE || s.min_length > s.max_length) return false;
+	if (s.format != "text" && s.format != "binary") return false;
+	return true;
+}
+
+
+//splitmix64 finalizer
+uint64_t Mix(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+
+//counter-based random generator: the value only depends on the seed, the
+//element index and the draw number, so that chunks can be generated
+//independently. The index is mixed before the draw is added, so that the
+//streams of different elements do not overlap however many draws they take
+uint64_t Random(uint64_t seed, uint64_t index, uint64_t draw) {
+	return Mix(Mix(seed + (index + 1) * 0x9E3779B97F4A7C15ULL) + (draw + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+
+double Uniform(uint64_t r) {
+	return (double)(r >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+//returns the first element index of each area (plus the total as last
+//entry), distributing the elements according to the area size distribution;
+//each area gets at least one element, if there are enough of them
+std::vector<long long> AreaBoundaries(const Settings& s) {
+	std::vector<double> weight(s.areas);
+	double total = 0;
+	for (int a = 0; a < s.areas; a++) {
+		if (s.distribution == "zipf") weight[a] = 1 / pow((double)(a + 1), s.zipf_s);
+		else if (s.distribution == "geometric") weight[a] = pow(1 - s.geometric_p, (double)a);
+		else weight[a] = 1;
+		total += weight[a];
+	}
+
+	long long floor_elements = (s.elements >= s.areas) ? 1 : 0;
+	long long spread = s.elements - floor_elements * s.areas;
+	std::vector<long long> size(s.areas);
+	std::vector<std::pair<double, int> > remainder(s.areas);
+	long long assigned = 0;
+	for (int a = 0; a < s.areas; a++) {
+		double share = spread * weight[a] / total;
+		size[a] = floor_elements + (long long)share;
+		remainder[a] = std::make_pair(share - floor(share), -a);
+		assigned += size[a];
+	}
+	//largest remainder rounding of the leftover elements
+	std::sort(remainder.rbegin(), remainder.rend());
+	for (long long i = 0; assigned < s.elements; i++, assigned++) size[-remainder[i % s.areas].second]++;
+
+	std::vector<long long> boundaries(s.areas + 1, 0);
+	for (int a = 0; a < s.areas; a++) boundaries[a + 1] = boundaries[a] + size[a];
+	return boundaries;
+}
+
+
+//writes the element with the given global index (members first, then
+//non-members) into out, returning its length
+int Element(const Settings& s, int digits, long long index, char* out) {
+	int length;
+	if (s.length == "fixed") length = s.max_length;
+	else if (s.length == "uniform") length = s.min_length + (int)(Random(s.seed, index, 0) % (uint64_t)(s.max_length - s.min_length + 1));
+	else {
+		//Box-Muller transform, centered between the bounds
+		double u1 = Uniform(Random(s.seed, index, 0)) + 1e-12, u2 = Uniform(Random(s.seed, index, 1));
+		double g = sqrt(-2 * log(u1)) * cos(2 * PI * u2);
+		length = (int)lround((s.min_length + s.max_length) / 2.0 + g * (s.max_length - s.min_length) / 6.0);
+		length = std::max(s.min_length, std::min(s.max_length, length));
+	}
+	if (length < digits) length = digits;
+
+	//random prefix, then the index in base 62
+	uint64_t r = Random(s.seed, index, 2);
+	for (int i = 0; i < length - digits; i++) {
+		if (i % 10 == 9) r = Random(s.seed, index, 3 + i);
+		out[i] = ALPHABET[r % 62];
+		r /= 62;
+	}
+	uint64_t v = (uint64_t)index;
+	for (int i = length - 1; i >= length - digits; i--) {
+		out[i] = ALPHABET[v % 62];
+		v /= 62;
+	}
+	return length;
+}
+
+
+void PutInteger(std::string& out, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) out += (char)((value >> (8 * i)) & 0xFF);
+}
+
+
+//generates the elements [first, first + count) of a dataset (in chunks, in
+//parallel) and writes them to path; boundaries is empty for verification
+//datasets
+bool Generate(const Settings& s, int digits, long long first, long long count, const std::vector<long long>& boundaries, const std::string& path) {
+	std::ofstream myfile(path.c_str(), std::ios::binary);
+	if (!myfile.is_open()) return false;
+
+	const bool binary = (s.format == "binary");
+	const int threads = sbf::ThreadCount(s.threads);
+
+	if (binary) {
+		std::string head("SBFDATA1");
+		PutInteger(head, (uint64_t)count, 8);
+		PutInteger(head, boundaries.empty() ? 0 : (uint64_t)s.areas, 4);
+		myfile << head;
+	}
+	else if (s.header && !boundaries.empty()) myfile << "#sbf members=" << count << " areas=" << s.areas << "\n";
+
+	long long chunks = (count + CHUNK - 1) / CHUNK;
+	for (long long base = 0; base < chunks; base += threads) {
+		long long batch = std::min((long long)threads, chunks - base);
+		std::vector<std::string> out(batch);
+
+		sbf::ParallelFor(threads, batch, [&](int, long long begin, long long end) {
+			char element[sbf::SBF::MAX_INPUT_SIZE];
+			for (long long c = begin; c < end; c++) {
+				long long from = (base + c) * CHUNK;
+				long long to = std::min(count, from + CHUNK);
+				std::string& buffer = out[c];
+				buffer.reserve((size_t)(to - from) * (s.max_length + 8));
+
+				int area = 0;
+				if (!boundaries.empty()) area = (int)(std::upper_bound(boundaries.begin(), boundaries.end(), from) - boundaries.begin());
+				for (long long i = from; i < to; i++) {
+					while (!boundaries.empty() && i >= boundaries[area]) area++;
+					int length = Element(s, digits, first + i, element);
+					if (binary) {
+						if (!boundaries.empty()) PutInteger(buffer, (uint64_t)area, 2);
+						PutInteger(buffer, (uint64_t)length, 1);
+						buffer.append(element, length);
+					}
+					else {
+						if (!boundaries.empty()) {
+							char label[8];
+							buffer.append(label, snprintf(label, sizeof(label), "%d,", area));
+						}
+						buffer.append(element, length);
+						buffer += '\n';
+					}
+				}
+			}
+		});
+
+		for (long long c = 0; c < batch; c++) myfile << out[c];
+	}
+
+	myfile.close();
+	return !myfile.fail();
+}
+
+
+int main(int argc, char** argv) {
+
+	Settings s;
+	if (!ParseArguments(argc, argv, s)) {
+		Usage();
+		return 1;
+	}
+
+	//number of base 62 digits needed to make every element unique
+	int digits = 1;
+	for (double space = 62; space < (double)(s.elements + s.non_elements); space *= 62) digits++;
+	if (digits > s.max_length) {
+		std::cerr << "Elements of at most " << s.max_length << " characters cannot be unique: increase --max-length" << std::endl;
+		return 1;
+	}
+
+	if (!Generate(s, digits, 0, s.elements, AreaBoundaries(s), s.members_file)) {
+		std::cerr << "Unable to write file " << s.members_file << std::endl;
+		return 1;
+	}
+	if (s.non_elements > 0 && !Generate(s, digits, s.elements, s.non_elements, std::vector<long long>(), s.non_members_file)) {
+		std::cerr << "Unable to write file " << s.non_members_file << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
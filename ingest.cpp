@@ -0,0 +1,490 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define SBF_DLL
+
+#include "ingest.h"
+#include "dataset.h"
+#include "parallel.h"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <stdlib.h>
+#include <thread>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// A block of whole lines read from the stream, tagged with its position
+struct Block
+{
+    long long seq;
+    std::string data;
+};
+
+
+// The hashed content of a block: one area label and HASH_number digests
+// for each element
+struct Parsed
+{
+    std::vector<int> areas;
+    std::vector<unsigned int> digests;
+};
+
+
+// Bounded queue handing blocks from the reader to the parser workers
+class BlockQueue
+{
+public:
+    BlockQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+    void Push(Block &block)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->not_full.wait(lock, [this] { return this->blocks.size() < this->capacity; });
+        this->blocks.push_back(Block());
+        this->blocks.back().seq = block.seq;
+        this->blocks.back().data.swap(block.data);
+        this->not_empty.notify_one();
+    }
+
+    // Returns false once the queue is closed and drained
+    bool Pop(Block &block)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->not_empty.wait(lock, [this] { return this->closed || !this->blocks.empty(); });
+        if (this->blocks.empty()) return false;
+        block.seq = this->blocks.front().seq;
+        block.data.swap(this->blocks.front().data);
+        this->blocks.pop_front();
+        this->not_full.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+        this->not_empty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    bool closed;
+    std::deque<Block> blocks;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+
+// Reads a "#sbf members=N areas=M" header line
+void ParseHeader(const char *line, size_t length, long long &members, int &areas)
+{
+    std::string header(line, length);
+    size_t pos;
+    if ((pos = header.find("members=")) != std::string::npos) members = atoll(header.c_str() + pos + 8);
+    if ((pos = header.find("areas=")) != std::string::npos) areas = atoi(header.c_str() + pos + 6);
+}
+
+} //namespace
+
+
+/* **************************** PRIVATE METHODS **************************** */
+
+
+// Runs the reader, parser and inserter stages over the input stream.
+// stream_size is the stream length in bytes (0 if unknown), tail_area the
+// area label of the last line (0 if unknown); both are only used to estimate
+// the filter size.
+SBF* Ingest::Pipeline(std::istream &in, long long stream_size, int tail_area)
+{
+    std::string carry, first;
+    long long header_members = 0, sample_lines = 0;
+    int header_areas = 0, sample_area = 0;
+    const char delimiter = this->options.delimiter;
+
+    // Reads the first block synchronously: it provides the (optional)
+    // header and the sample used to estimate the dataset size
+    bool more = ReadBlock(in, this->options.block_size, carry, first);
+    bool exhausted = !in.good() && carry.empty();
+
+    ForEachLine(first, [&](const char *line, size_t length) {
+        if (line[0] == '#') {
+            if (sample_lines == 0 && length >= 4 && memcmp(line, "#sbf", 4) == 0) ParseHeader(line, length, header_members, header_areas);
+            return;
+        }
+        const char *element;
+        int element_length;
+        int area = ParseLine(line, length, delimiter, element, element_length);
+        if (area < 1) throw std::invalid_argument("Invalid area label.");
+        if (area > sample_area) sample_area = area;
+        sample_lines++;
+    });
+
+    if (!more) throw std::runtime_error("Empty construction dataset.");
+
+    // Estimates the number of elements and areas (hints take precedence over
+    // the header, which takes precedence over the sample)
+    if (this->options.expected_members > 0) this->estimated_members = this->options.expected_members;
+    else if (header_members > 0) this->estimated_members = header_members;
+    else if (exhausted) this->estimated_members = sample_lines;
+    else if (stream_size > (long long)first.size()) this->estimated_members = (long long)((double)sample_lines * (double)stream_size / (double)first.size());
+    else this->estimated_members = sample_lines;
+    if (this->estimated_members <= 0) this->estimated_members = 1;
+
+    if (this->options.expected_areas > 0) this->estimated_areas = this->options.expected_areas;
+    else if (header_areas > 0) this->estimated_areas = header_areas;
+    else this->estimated_areas = (sample_area > tail_area) ? sample_area : tail_area;
+    if (this->estimated_areas <= 0) this->estimated_areas = 1;
+
+    SBF *filter = new SBF(this->TargetBitMapping(this->estimated_members), this->options.HASH_family, this->HASH_number, this->estimated_areas, this->options.salt_path);
+
+    const int k = this->HASH_number;
+    const int threads = ThreadCount(this->options.threads);
+
+    this->areas.reserve((size_t)this->estimated_members);
+    this->digests.reserve((size_t)this->estimated_members * k);
+
+    // State shared by the parser workers and the inserter: parsed blocks
+    // waiting to be inserted (in order), and the total number of blocks
+    // (known once the reader is done)
+    std::mutex mutex;
+    std::condition_variable ready, drained;
+    std::map<long long, Parsed> parsed;
+    long long next = 0;
+    long long total_blocks = -1;
+    const long long window = 4 * (long long)threads;
+
+    BlockQueue queue(2 * threads);
+    Block block;
+    this->bytes = (long long)first.size();
+    block.seq = 0;
+    block.data.swap(first);
+    queue.Push(block);
+
+    // Reader stage
+    std::thread reader([&] {
+        Block b;
+        b.seq = 1;
+        while (ReadBlock(in, this->options.block_size, carry, b.data)) {
+            this->bytes += (long long)b.data.size();
+            queue.Push(b);
+            b.seq++;
+        }
+        queue.Close();
+        std::lock_guard<std::mutex> lock(mutex);
+        total_blocks = b.seq;
+        ready.notify_all();
+    });
+
+    // Parser stage: each worker hashes whole blocks
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&] {
+            Block b;
+            while (queue.Pop(b)) {
+                Parsed p;
+                ForEachLine(b.data, [&](const char *line, size_t length) {
+                    if (line[0] == '#') return;
+                    const char *element;
+                    int element_length;
+                    p.areas.push_back(ParseLine(line, length, delimiter, element, element_length));
+                    p.digests.resize(p.digests.size() + k);
+                    filter->Digest(element, element_length, &p.digests[p.digests.size() - k]);
+                });
+
+                // Waits for the inserter to catch up, so that at most
+                // 'window' blocks are buffered
+                std::unique_lock<std::mutex> lock(mutex);
+                drained.wait(lock, [&] { return b.seq < next + window; });
+                parsed[b.seq].areas.swap(p.areas);
+                parsed[b.seq].digests.swap(p.digests);
+                ready.notify_all();
+            }
+        }));
+    }
+
+    // Inserter stage: maps the elements in their original order, as long as
+    // the estimated filter can hold them. Once an invalid label is found,
+    // the remaining blocks are only drained, so that the threads can be
+    // joined before throwing
+    bool live = true;
+    bool invalid = false;
+    while (true) {
+        Parsed p;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&] { return parsed.count(next) > 0 || (total_blocks >= 0 && next >= total_blocks); });
+            if (parsed.count(next) == 0) break;
+            p.areas.swap(parsed[next].areas);
+            p.digests.swap(parsed[next].digests);
+            parsed.erase(next);
+            next++;
+            drained.notify_all();
+        }
+
+        for (size_t i = 0; i < p.areas.size() && !invalid; i++) {
+            if (p.areas[i] < 1) invalid = true;
+        }
+        if (invalid) continue;
+
+        for (size_t i = 0; i < p.areas.size(); i++) {
+            if (live && p.areas[i] > filter->GetAreaNumber()) live = false;
+            if (live) filter->InsertDigests(&p.digests[i * k], p.areas[i]);
+            if (p.areas[i] > this->AREA_number) this->AREA_number = p.areas[i];
+        }
+        this->areas.insert(this->areas.end(), p.areas.begin(), p.areas.end());
+        this->digests.insert(this->digests.end(), p.digests.begin(), p.digests.end());
+    }
+
+    reader.join();
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+
+    if (invalid) {
+        delete filter;
+        this->ReleaseBuffer();
+        throw std::invalid_argument("Invalid area label.");
+    }
+
+    this->members = (long long)this->areas.size();
+    if (this->members == 0) {
+        delete filter;
+        throw std::runtime_error("Empty construction dataset.");
+    }
+
+    // Rebuilds the filter from the buffered digests if the estimate was off
+    if (!live || filter->GetBitMapping() != this->TargetBitMapping(this->members) || filter->GetAreaNumber() != this->AREA_number) {
+        filter = this->Rebuild(filter);
+    }
+
+    return filter;
+}
+
+
+// Replaces the filter with one sized after the actual number of elements and
+// areas, and maps the buffered digests into it. The hash salts are loaded
+// from the salt file written when the first filter was constructed.
+SBF* Ingest::Rebuild(SBF *filter)
+{
+    const int k = this->HASH_number;
+
+    delete filter;
+    filter = new SBF(this->TargetBitMapping(this->members), this->options.HASH_family, k, this->AREA_number, this->options.salt_path);
+
+    for (size_t i = 0; i < this->areas.size(); i++) {
+        filter->InsertDigests(&this->digests[i * k], this->areas[i]);
+    }
+
+    this->rebuilds++;
+    return filter;
+}
+
+
+// Returns the bit_mapping of the filter for the given number of elements:
+// the one set in the options, if any, or the one achieving max_fpp
+int Ingest::TargetBitMapping(long long members) const
+{
+    if (this->options.bit_mapping > 0) return this->options.bit_mapping;
+    return Ingest::BitMapping(members, this->options.max_fpp);
+}
+
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+IngestOptions::IngestOptions()
+{
+    this->HASH_family = 4;
+    this->HASH_number = 0;
+    this->max_fpp = 0.001;
+    this->bit_mapping = 0;
+    this->delimiter = ',';
+    this->threads = 0;
+    this->block_size = 1 << 20;
+    this->expected_members = 0;
+    this->expected_areas = 0;
+}
+
+
+Ingest::Ingest(const IngestOptions &options)
+{
+    if (options.max_fpp <= 0 || options.max_fpp >= 1) throw std::invalid_argument("Invalid false positives probability.");
+    if (options.bit_mapping < 0 || options.bit_mapping > SBF::MAX_BIT_MAPPING) throw std::invalid_argument("Invalid bit mapping.");
+    if (options.HASH_number < 0 || options.HASH_number > SBF::MAX_HASH_NUMBER) throw std::invalid_argument("Invalid number of hash runs.");
+    if (options.block_size <= 0) throw std::invalid_argument("Invalid block size.");
+    if (options.salt_path.length() == 0) throw std::invalid_argument("Invalid hash salt path.");
+
+    this->options = options;
+    this->HASH_number = (options.HASH_number > 0) ? options.HASH_number : Ingest::HashNumber(options.max_fpp);
+    this->members = 0;
+    this->AREA_number = 0;
+    this->estimated_members = 0;
+    this->estimated_areas = 0;
+    this->bytes = 0;
+    this->rebuilds = 0;
+}
+
+
+// Builds a filter from the construction dataset at path, reading it once.
+// If path is "-", the dataset is read from the standard input. Returns the
+// filter, to be deleted by the caller. Throws std::invalid_argument if an
+// area label is lower than 1.
+SBF* Ingest::Run(const std::string &path)
+{
+    if (path == "-") return this->Pipeline(std::cin, 0, 0);
+
+    std::ifstream myfile(path.c_str(), std::ios::binary);
+    if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+
+    // For regular files, the size and the label of the last line (the
+    // highest one, as areas are in ascending order) improve the estimate
+    long long stream_size = 0;
+    int tail_area = 0;
+    myfile.seekg(0, std::ios::end);
+    std::streamoff end = myfile.tellg();
+    if (end > 0) {
+        stream_size = (long long)end;
+        std::string tail((size_t)(end < 4096 ? end : 4096), '\0');
+        myfile.seekg(end - (std::streamoff)tail.size());
+        myfile.read(&tail[0], tail.size());
+        while (!tail.empty() && (tail[tail.size() - 1] == '\n' || tail[tail.size() - 1] == '\r')) tail.resize(tail.size() - 1);
+        size_t begin = tail.rfind('\n');
+        begin = (begin == std::string::npos) ? 0 : begin + 1;
+        if (begin > 0 || end <= 4096) tail_area = atoi(tail.c_str() + begin);
+    }
+    myfile.clear();
+    myfile.seekg(0, std::ios::beg);
+
+    return this->Pipeline(myfile, stream_size, tail_area);
+}
+
+
+// Builds a filter from a construction dataset read from the given stream
+// (e.g. a pipe). stream_size is the expected length in bytes (0 if unknown).
+// Returns the filter, to be deleted by the caller. Throws as above.
+SBF* Ingest::Run(std::istream &in, long long stream_size)
+{
+    return this->Pipeline(in, stream_size, 0);
+}
+
+
+// Returns the number of ingested elements
+long long Ingest::GetMembers() const
+{
+    return this->members;
+}
+
+
+// Returns the number of areas (the highest area label found)
+int Ingest::GetAreaNumber() const
+{
+    return this->AREA_number;
+}
+
+
+// Returns the number of digests buffered for each element
+int Ingest::GetHashNumber() const
+{
+    return this->HASH_number;
+}
+
+
+// Returns the number of elements estimated before construction
+long long Ingest::GetEstimatedMembers() const
+{
+    return this->estimated_members;
+}
+
+
+// Returns the number of areas estimated before construction
+int Ingest::GetEstimatedAreas() const
+{
+    return this->estimated_areas;
+}
+
+
+// Returns the number of bytes read from the dataset
+long long Ingest::GetBytes() const
+{
+    return this->bytes;
+}
+
+
+// Returns the number of times the filter was rebuilt from the buffer
+// (0 if the estimate matched the dataset)
+int Ingest::GetRebuilds() const
+{
+    return this->rebuilds;
+}
+
+
+// Returns the area labels of the ingested elements, in dataset order
+// (GetMembers entries)
+const int *Ingest::GetAreas() const
+{
+    return this->areas.empty() ? NULL : &this->areas[0];
+}
+
+
+// Returns the digests of the ingested elements, in dataset order
+// (GetHashNumber entries per element, see SBF::CheckDigests)
+const unsigned int *Ingest::GetDigests() const
+{
+    return this->digests.empty() ? NULL : &this->digests[0];
+}
+
+
+// Frees the buffered area labels and digests
+void Ingest::ReleaseBuffer()
+{
+    std::vector<int>().swap(this->areas);
+    std::vector<unsigned int>().swap(this->digests);
+}
+
+
+// Returns the number of digests minimizing the false positives probability
+// of a filter sized for max_fpp. This is ln(2) times the number of cells per
+// element, and does not depend on the number of elements.
+int Ingest::HashNumber(double max_fpp)
+{
+    return (int)ceil(-log(max_fpp) / log(2));
+}
+
+
+// Returns the bit_mapping of the smallest filter achieving max_fpp with the
+// given number of elements
+int Ingest::BitMapping(long long members, double max_fpp)
+{
+    double cells = ceil((double)-members * log(max_fpp) / pow(log(2), 2));
+    int bit_mapping = (int)ceil(log2(cells));
+    return (bit_mapping < 1) ? 1 : bit_mapping;
+}
+
+} //namespace sbf
@@ -0,0 +1,123 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "sbf.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+
+namespace sbf {
+
+	// Settings of the streaming ingestion pipeline (see the Ingest class)
+	struct DLL_PUBLIC IngestOptions
+	{
+		// Hash function to be used (see the SBF constructor)
+		int HASH_family;
+		// Number of digests per element. When 0, it is derived from max_fpp
+		// (see Ingest::HashNumber)
+		int HASH_number;
+		// Desired false positives probability (upper bound), used to size
+		// the filter once the number of elements is known
+		double max_fpp;
+		// Fixed size of the filter (see the SBF constructor). When 0, the
+		// filter is sized for max_fpp
+		int bit_mapping;
+		// Path to the hash salt file (see the SBF constructor)
+		std::string salt_path;
+		// Delimiter between the area label and the element in each line
+		char delimiter;
+		// Number of parser workers (0 uses the available hardware threads)
+		int threads;
+		// Size in bytes of the blocks handed from the reader to the parsers
+		int block_size;
+		// Sizing hints: number of elements and number of areas of the
+		// dataset. When 0, they are read from the dataset header or estimated
+		// from the first block and the stream size
+		long long expected_members;
+		int expected_areas;
+
+		IngestOptions();
+	};
+
+
+	// Streaming ingestion pipeline for construction datasets (one
+	// "area,element" pair per line, in ascending order of area labels).
+	// The dataset is read exactly once: a reader thread splits the stream into
+	// blocks of whole lines, parser workers hash the elements of each block
+	// into their truncated 32-bit digests (see SBF::Digest), and the inserter
+	// maps them into the filter in the original order.
+	// Since the filter must be constructed before its final size is known,
+	// it is sized from the hints, from an optional "#sbf members=N areas=M"
+	// header line, or estimated from the first block and the stream size.
+	// The digests are buffered, so that a wrong estimate only requires the
+	// filter to be rebuilt from the buffer (no re-parsing or re-hashing), and
+	// the buffer can later be used to self-check the filter.
+	class DLL_PUBLIC Ingest
+	{
+
+	private:
+		IngestOptions options;
+		int HASH_number;
+		long long members;
+		int AREA_number;
+		long long estimated_members;
+		int estimated_areas;
+		long long bytes;
+		int rebuilds;
+		std::vector<int> areas;
+		std::vector<unsigned int> digests;
+
+		// Private methods (commented in the ingest.cpp)
+		SBF* Pipeline(std::istream &in, long long stream_size, int tail_area);
+		SBF* Rebuild(SBF *filter);
+		int TargetBitMapping(long long members) const;
+
+
+	public:
+		Ingest(const IngestOptions &options);
+
+		// Public methods (commented in the ingest.cpp)
+		SBF* Run(const std::string &path);
+		SBF* Run(std::istream &in, long long stream_size);
+		long long GetMembers() const;
+		int GetAreaNumber() const;
+		int GetHashNumber() const;
+		long long GetEstimatedMembers() const;
+		int GetEstimatedAreas() const;
+		long long GetBytes() const;
+		int GetRebuilds() const;
+		const int *GetAreas() const;
+		const unsigned int *GetDigests() const;
+		void ReleaseBuffer();
+		static int HashNumber(double max_fpp);
+		static int BitMapping(long long members, double max_fpp);
+	};
+
+} //namespace sbf
+
+#endif /* INGEST_H */
@@ -0,0 +1,570 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define SBF_DLL
+
+#include "instrument.h"
+
+#include <atomic>
+#include <fstream>
+#include <math.h>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// Each recording thread gets a slot at its first use; threads are assigned
+// to shards round robin
+std::atomic<unsigned int> next_slot(0);
+
+unsigned int ThreadSlot()
+{
+    thread_local unsigned int slot = next_slot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+
+// Per-thread count of the accesses seen by the heatmaps, used for sampling
+thread_local unsigned int heatmap_ticks = 0;
+
+
+// Relaxed atomic counters: updates do not order memory, they only ensure
+// that snapshots taken concurrently read consistent values
+typedef std::atomic<uint64_t> Counter;
+
+inline void Increment(Counter &counter, uint64_t value = 1)
+{
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+inline void Maximum(Counter &counter, uint64_t value)
+{
+    uint64_t current = counter.load(std::memory_order_relaxed);
+    while (value > current && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+
+// Shared histogram representation used by the shards
+struct AtomicHistogram
+{
+    Counter counts[LatencyHistogram::BUCKETS];
+    Counter sum;
+    Counter max;
+
+    AtomicHistogram() : sum(0), max(0)
+    {
+        for (int b = 0; b < LatencyHistogram::BUCKETS; b++) counts[b].store(0, std::memory_order_relaxed);
+    }
+
+    void Record(uint64_t ns)
+    {
+        Increment(this->counts[LatencyHistogram::Bucket(ns)]);
+        Increment(this->sum, ns);
+        Maximum(this->max, ns);
+    }
+
+    void MergeInto(LatencyHistogram &histogram) const
+    {
+        LatencyHistogram shard;
+        uint64_t count = 0;
+        for (int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+            uint64_t c = this->counts[b].load(std::memory_order_relaxed);
+            if (c > 0) shard.Add(b, c);
+            count += c;
+        }
+        shard.SetTotals(count, this->sum.load(std::memory_order_relaxed), this->max.load(std::memory_order_relaxed));
+        histogram.Merge(shard);
+    }
+};
+
+} //namespace
+
+
+// Per-thread counters. The leading padding keeps the hot counters of a shard
+// off the cache line holding the tail of the previous one.
+struct Instrumentation::Shard
+{
+    char padding[64];
+    Counter inserts;
+    Counter checks;
+    Counter check_early_exits;
+    Counter hash_calls;
+    AtomicHistogram insert_latency;
+    AtomicHistogram check_latency;
+    std::vector<Counter> check_results;
+    std::vector<Counter> insert_collisions;
+
+    Shard() : inserts(0), checks(0), check_early_exits(0), hash_calls(0) {}
+};
+
+
+// Access counters of a heatmap region
+struct CellHeatmap::Region
+{
+    Counter sets;
+    Counter gets;
+
+    Region() : sets(0), gets(0) {}
+};
+
+
+/* ************************** HISTOGRAM METHODS **************************** */
+
+
+LatencyHistogram::LatencyHistogram() : counts(LatencyHistogram::BUCKETS, 0)
+{
+    this->count = 0;
+    this->sum = 0;
+    this->max = 0;
+}
+
+
+// Returns the bucket of the input value
+int LatencyHistogram::Bucket(uint64_t ns)
+{
+    if (ns < ((uint64_t)1 << SUB_BITS)) return (int)ns;
+
+    int exponent = 63;
+    while (!(ns >> exponent)) exponent--;
+
+    int sub = (int)((ns >> (exponent - SUB_BITS)) & (((uint64_t)1 << SUB_BITS) - 1));
+    return ((exponent - SUB_BITS + 1) << SUB_BITS) + sub;
+}
+
+
+// Returns the lowest value falling in the input bucket
+uint64_t LatencyHistogram::BucketValue(int bucket)
+{
+    if (bucket < (1 << SUB_BITS)) return (uint64_t)bucket;
+
+    int exponent = (bucket >> SUB_BITS) + SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(bucket & ((1 << SUB_BITS) - 1));
+    return ((uint64_t)1 << exponent) | (sub << (exponent - SUB_BITS));
+}
+
+
+// Adds count values to the input bucket (totals are left unchanged)
+void LatencyHistogram::Add(int bucket, uint64_t count)
+{
+    this->counts[bucket] += count;
+}
+
+
+// Records a value (in nanoseconds)
+void LatencyHistogram::Record(uint64_t ns)
+{
+    this->counts[LatencyHistogram::Bucket(ns)]++;
+    this->count++;
+    this->sum += ns;
+    if (ns > this->max) this->max = ns;
+}
+
+
+// Adds the values recorded by another histogram
+void LatencyHistogram::Merge(const LatencyHistogram &other)
+{
+    for (int b = 0; b < LatencyHistogram::BUCKETS; b++) this->counts[b] += other.counts[b];
+    this->count += other.count;
+    this->sum += other.sum;
+    if (other.max > this->max) this->max = other.max;
+}
+
+
+// Returns the number of recorded values
+uint64_t LatencyHistogram::GetCount() const
+{
+    return this->count;
+}
+
+
+// Returns the highest recorded value
+uint64_t LatencyHistogram::GetMax() const
+{
+    return this->max;
+}
+
+
+// Returns the mean of the recorded values
+double LatencyHistogram::GetMean() const
+{
+    return (this->count == 0) ? 0 : (double)this->sum / (double)this->count;
+}
+
+
+// Returns the value below which the input percentage (0-100) of the recorded
+// values fall (as the lowest value of its bucket, capped to the maximum)
+uint64_t LatencyHistogram::GetPercentile(double percentile) const
+{
+    uint64_t total = 0;
+    for (int b = 0; b < LatencyHistogram::BUCKETS; b++) total += this->counts[b];
+    if (total == 0) return 0;
+
+    uint64_t rank = (uint64_t)ceil(percentile / 100 * (double)total);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+        seen += this->counts[b];
+        if (seen >= rank) {
+            uint64_t value = LatencyHistogram::BucketValue(b);
+            return (value > this->max && this->max > 0) ? this->max : value;
+        }
+    }
+    return this->max;
+}
+
+
+// Returns the number of values in the input bucket
+uint64_t LatencyHistogram::GetBucketCount(int bucket) const
+{
+    return this->counts[bucket];
+}
+
+
+// Sets the totals (count, sum and maximum) of a histogram filled by Add
+void LatencyHistogram::SetTotals(uint64_t count, uint64_t sum, uint64_t max)
+{
+    this->count = count;
+    this->sum = sum;
+    this->max = max;
+}
+
+
+/* *************************** SNAPSHOT METHODS **************************** */
+
+
+InstrumentationSnapshot::InstrumentationSnapshot()
+{
+    this->inserts = 0;
+    this->checks = 0;
+    this->check_early_exits = 0;
+    this->hash_calls = 0;
+}
+
+
+// Adds the counters of another snapshot (e.g. of another filter)
+void InstrumentationSnapshot::Merge(const InstrumentationSnapshot &other)
+{
+    this->inserts += other.inserts;
+    this->checks += other.checks;
+    this->insert_latency.Merge(other.insert_latency);
+    this->check_latency.Merge(other.check_latency);
+    this->check_early_exits += other.check_early_exits;
+    this->hash_calls += other.hash_calls;
+
+    if (this->check_results.size() < other.check_results.size()) this->check_results.resize(other.check_results.size(), 0);
+    for (size_t a = 0; a < other.check_results.size(); a++) this->check_results[a] += other.check_results[a];
+    if (this->insert_collisions.size() < other.insert_collisions.size()) this->insert_collisions.resize(other.insert_collisions.size(), 0);
+    for (size_t c = 0; c < other.insert_collisions.size(); c++) this->insert_collisions[c] += other.insert_collisions[c];
+}
+
+
+// Writes the snapshot onto a CSV file (path): counters and latency
+// percentiles (CSV: key;value), then the check results per area (CSV:
+// area;checks) and the inserts per number of collisions (CSV:
+// collisions;inserts)
+void InstrumentationSnapshot::SaveToDisk(const std::string path) const
+{
+    std::ofstream myfile;
+    const double percentiles[] = { 50, 90, 99, 99.9 };
+
+    myfile.open(path.c_str());
+
+    myfile << "inserts" << ";" << this->inserts << std::endl;
+    myfile << "checks" << ";" << this->checks << std::endl;
+    myfile << "check early exits" << ";" << this->check_early_exits << std::endl;
+    myfile << "hash calls" << ";" << this->hash_calls << std::endl;
+    for (int p = 0; p < 4; p++) {
+        myfile << "insert p" << percentiles[p] << " ns" << ";" << this->insert_latency.GetPercentile(percentiles[p]) << std::endl;
+    }
+    myfile << "insert max ns" << ";" << this->insert_latency.GetMax() << std::endl;
+    for (int p = 0; p < 4; p++) {
+        myfile << "check p" << percentiles[p] << " ns" << ";" << this->check_latency.GetPercentile(percentiles[p]) << std::endl;
+    }
+    myfile << "check max ns" << ";" << this->check_latency.GetMax() << std::endl;
+
+    myfile << "area" << ";" << "checks" << std::endl;
+    for (size_t a = 0; a < this->check_results.size(); a++) {
+        myfile << a << ";" << this->check_results[a] << std::endl;
+    }
+
+    myfile << "collisions" << ";" << "inserts" << std::endl;
+    for (size_t c = 0; c < this->insert_collisions.size(); c++) {
+        myfile << c << ";" << this->insert_collisions[c] << std::endl;
+    }
+
+    myfile.close();
+}
+
+
+/* ************************ INSTRUMENTATION METHODS ************************ */
+
+
+Instrumentation::Instrumentation(int AREA_number, int HASH_number)
+{
+    this->AREA_number = AREA_number;
+    this->HASH_number = HASH_number;
+    this->shards = new Shard[Instrumentation::SHARDS];
+    for (int s = 0; s < Instrumentation::SHARDS; s++) {
+        this->shards[s].check_results = std::vector<Counter>(AREA_number + 1);
+        this->shards[s].insert_collisions = std::vector<Counter>(HASH_number + 1);
+        for (int a = 0; a <= AREA_number; a++) this->shards[s].check_results[a].store(0);
+        for (int c = 0; c <= HASH_number; c++) this->shards[s].insert_collisions[c].store(0);
+    }
+}
+
+
+Instrumentation::~Instrumentation()
+{
+    delete[] this->shards;
+}
+
+
+// Returns the shard of the calling thread
+Instrumentation::Shard &Instrumentation::LocalShard()
+{
+    return this->shards[ThreadSlot() % Instrumentation::SHARDS];
+}
+
+
+// Records an Insert call: its latency, the collisions it hit and the number
+// of hash calls it made
+void Instrumentation::RecordInsert(uint64_t ns, int collisions, int hash_calls)
+{
+    Shard &shard = this->LocalShard();
+    Increment(shard.inserts);
+    shard.insert_latency.Record(ns);
+    if (collisions > this->HASH_number) collisions = this->HASH_number;
+    Increment(shard.insert_collisions[collisions]);
+    Increment(shard.hash_calls, (uint64_t)hash_calls);
+}
+
+
+// Records a Check call: its latency, the returned area, whether it stopped
+// early and the number of hash calls it made
+void Instrumentation::RecordCheck(uint64_t ns, int area, bool early_exit, int hash_calls)
+{
+    Shard &shard = this->LocalShard();
+    Increment(shard.checks);
+    shard.check_latency.Record(ns);
+    if (area >= 0 && area <= this->AREA_number) Increment(shard.check_results[area]);
+    if (early_exit) Increment(shard.check_early_exits);
+    Increment(shard.hash_calls, (uint64_t)hash_calls);
+}
+
+
+// Records hash calls made outside Insert and Check (i.e. by Digest)
+void Instrumentation::RecordHashCalls(int hash_calls)
+{
+    Increment(this->LocalShard().hash_calls, (uint64_t)hash_calls);
+}
+
+
+// Returns the counters collected so far, merged across shards
+InstrumentationSnapshot Instrumentation::GetSnapshot() const
+{
+    InstrumentationSnapshot snapshot;
+    snapshot.check_results.assign(this->AREA_number + 1, 0);
+    snapshot.insert_collisions.assign(this->HASH_number + 1, 0);
+
+    for (int s = 0; s < Instrumentation::SHARDS; s++) {
+        const Shard &shard = this->shards[s];
+        snapshot.inserts += shard.inserts.load(std::memory_order_relaxed);
+        snapshot.checks += shard.checks.load(std::memory_order_relaxed);
+        snapshot.check_early_exits += shard.check_early_exits.load(std::memory_order_relaxed);
+        snapshot.hash_calls += shard.hash_calls.load(std::memory_order_relaxed);
+        shard.insert_latency.MergeInto(snapshot.insert_latency);
+        shard.check_latency.MergeInto(snapshot.check_latency);
+        for (int a = 0; a <= this->AREA_number; a++) snapshot.check_results[a] += shard.check_results[a].load(std::memory_order_relaxed);
+        for (int c = 0; c <= this->HASH_number; c++) snapshot.insert_collisions[c] += shard.insert_collisions[c].load(std::memory_order_relaxed);
+    }
+
+    return snapshot;
+}
+
+
+// Returns the memory taken by the counters, in bytes
+size_t Instrumentation::GetBytes() const
+{
+    return sizeof(Instrumentation) + Instrumentation::SHARDS * (sizeof(Shard) + (this->AREA_number + 1 + this->HASH_number + 1) * sizeof(Counter));
+}
+
+
+/* *********************** HEATMAP SNAPSHOT METHODS ************************ */
+
+
+HeatmapSnapshot::HeatmapSnapshot()
+{
+    this->region_bytes = 0;
+    this->region_cells = 0;
+    this->sample_period = 1;
+}
+
+
+// Returns the total number of sampled accesses (sets and gets)
+uint64_t HeatmapSnapshot::GetTotal() const
+{
+    uint64_t total = 0;
+    for (size_t r = 0; r < this->sets.size(); r++) total += this->sets[r] + this->gets[r];
+    return total;
+}
+
+
+// Returns the highest number of sampled accesses to a single region
+uint64_t HeatmapSnapshot::GetMax() const
+{
+    uint64_t max = 0;
+    for (size_t r = 0; r < this->sets.size(); r++) {
+        if (this->sets[r] + this->gets[r] > max) max = this->sets[r] + this->gets[r];
+    }
+    return max;
+}
+
+
+// Returns the ratio between the accesses to the hottest region and the mean
+// accesses per region (1 for a perfectly even load, 0 if nothing was
+// sampled)
+double HeatmapSnapshot::GetSkew() const
+{
+    uint64_t total = this->GetTotal();
+    if (total == 0) return 0;
+    return (double)this->GetMax() * (double)this->sets.size() / (double)total;
+}
+
+
+// Returns the coefficient of variation (standard deviation over mean) of
+// the accesses per region
+double HeatmapSnapshot::GetVariation() const
+{
+    uint64_t total = this->GetTotal();
+    if (total == 0) return 0;
+
+    double mean = (double)total / (double)this->sets.size();
+    double variance = 0;
+    for (size_t r = 0; r < this->sets.size(); r++) {
+        double d = (double)(this->sets[r] + this->gets[r]) - mean;
+        variance += d * d;
+    }
+    variance /= (double)this->sets.size();
+    return sqrt(variance) / mean;
+}
+
+
+// Writes the heatmap onto a CSV file (path): summary values (CSV:
+// key;value), then the sampled accesses per region (CSV: region;first
+// cell;sets;gets)
+void HeatmapSnapshot::SaveToDisk(const std::string path) const
+{
+    std::ofstream myfile;
+
+    myfile.open(path.c_str());
+
+    myfile << "region bytes" << ";" << this->region_bytes << std::endl;
+    myfile << "region cells" << ";" << this->region_cells << std::endl;
+    myfile << "regions" << ";" << this->sets.size() << std::endl;
+    myfile << "sample period" << ";" << this->sample_period << std::endl;
+    myfile << "sampled accesses" << ";" << this->GetTotal() << std::endl;
+    myfile << "max accesses" << ";" << this->GetMax() << std::endl;
+    myfile << "skew" << ";" << this->GetSkew() << std::endl;
+    myfile << "variation" << ";" << this->GetVariation() << std::endl;
+
+    myfile << "region" << ";" << "first cell" << ";" << "sets" << ";" << "gets" << std::endl;
+    for (size_t r = 0; r < this->sets.size(); r++) {
+        myfile << r << ";" << (uint64_t)r * this->region_cells << ";" << this->sets[r] << ";" << this->gets[r] << std::endl;
+    }
+
+    myfile.close();
+}
+
+
+/* ************************** CELL HEATMAP METHODS ************************* */
+
+
+// Regions span region_bytes bytes of the cell array (at least one cell);
+// sample_period is rounded up to a power of two so that sampling is a mask
+CellHeatmap::CellHeatmap(int cells, int cell_size, int region_bytes, int sample_period)
+{
+    this->region_bytes = region_bytes;
+    this->region_cells = region_bytes / cell_size;
+    if (this->region_cells < 1) this->region_cells = 1;
+    this->region_number = (int)(((long long)cells + this->region_cells - 1) / this->region_cells);
+    this->sample_period = 1;
+    while (this->sample_period < sample_period && this->sample_period < (1 << 30)) this->sample_period <<= 1;
+    this->regions = new Region[this->region_number];
+}
+
+
+CellHeatmap::~CellHeatmap()
+{
+    delete[] this->regions;
+}
+
+
+// Returns true if the current access of the calling thread is to be counted
+bool CellHeatmap::Sample() const
+{
+    return ((heatmap_ticks++) & (unsigned int)(this->sample_period - 1)) == 0;
+}
+
+
+// Records a write to the cell at the input index
+void CellHeatmap::RecordSet(unsigned int index)
+{
+    if (this->Sample()) Increment(this->regions[index / this->region_cells].sets);
+}
+
+
+// Records a read of the cell at the input index
+void CellHeatmap::RecordGet(unsigned int index)
+{
+    if (this->Sample()) Increment(this->regions[index / this->region_cells].gets);
+}
+
+
+// Returns the access counts collected so far
+HeatmapSnapshot CellHeatmap::GetSnapshot() const
+{
+    HeatmapSnapshot snapshot;
+    snapshot.region_bytes = this->region_bytes;
+    snapshot.region_cells = this->region_cells;
+    snapshot.sample_period = this->sample_period;
+    snapshot.sets.resize(this->region_number);
+    snapshot.gets.resize(this->region_number);
+
+    for (int r = 0; r < this->region_number; r++) {
+        snapshot.sets[r] = this->regions[r].sets.load(std::memory_order_relaxed);
+        snapshot.gets[r] = this->regions[r].gets.load(std::memory_order_relaxed);
+    }
+
+    return snapshot;
+}
+
+
+// Returns the memory taken by the counters, in bytes
+size_t CellHeatmap::GetBytes() const
+{
+    return sizeof(CellHeatmap) + (size_t)this->region_number * sizeof(Region);
+}
+
+} //namespace sbf
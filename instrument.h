@@ -0,0 +1,200 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+// OS specific headers
+#if defined(__MINGW32__) || defined(__MINGW64__)
+#include "win/libexport.h"
+#elif defined(_MSC_VER)
+#include "win/libexport.h"
+#elif __GNUC__
+#include "linux/libexport.h"
+#endif
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+namespace sbf {
+
+	// Log-linear latency histogram (in the style of HdrHistogram): values
+	// below 2^SUB_BITS nanoseconds have their own bucket, larger values are
+	// grouped by power of two, each split in 2^SUB_BITS sub-buckets. The
+	// relative error of the reported values is thus below 2^-SUB_BITS.
+	class DLL_PUBLIC LatencyHistogram
+	{
+
+	private:
+		std::vector<uint64_t> counts;
+		uint64_t count;
+		uint64_t sum;
+		uint64_t max;
+
+	public:
+		// Number of sub-buckets (as a power of two) for each power of two
+		const static int SUB_BITS = 4;
+		// Total number of buckets, covering the full 64-bit range
+		const static int BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+		LatencyHistogram();
+
+		// Public methods (commented in the instrument.cpp)
+		static int Bucket(uint64_t ns);
+		static uint64_t BucketValue(int bucket);
+		void Add(int bucket, uint64_t count);
+		void Record(uint64_t ns);
+		void Merge(const LatencyHistogram &other);
+		uint64_t GetCount() const;
+		uint64_t GetMax() const;
+		double GetMean() const;
+		uint64_t GetPercentile(double percentile) const;
+		uint64_t GetBucketCount(int bucket) const;
+		void SetTotals(uint64_t count, uint64_t sum, uint64_t max);
+	};
+
+
+	// A point-in-time copy of the counters collected for a filter. Snapshots
+	// of different filters (or taken at different times) can be merged.
+	struct DLL_PUBLIC InstrumentationSnapshot
+	{
+		// Insert and Check calls, and their latencies
+		uint64_t inserts;
+		uint64_t checks;
+		LatencyHistogram insert_latency;
+		LatencyHistogram check_latency;
+		// Checks which stopped before computing all the digests, because
+		// one of them pointed to an empty cell
+		uint64_t check_early_exits;
+		// Calls to the hash function (by Insert, Check, CheckArea, CheckAnyOf
+		// and Digest)
+		uint64_t hash_calls;
+		// Check results per returned area label (index 0: not found)
+		std::vector<uint64_t> check_results;
+		// Number of inserts which hit a given number of collisions (index),
+		// from 0 to HASH_number
+		std::vector<uint64_t> insert_collisions;
+
+		InstrumentationSnapshot();
+
+		void Merge(const InstrumentationSnapshot &other);
+		void SaveToDisk(const std::string path) const;
+	};
+
+
+	// Counters collected by an SBF when compiled with SBF_INSTRUMENTATION and
+	// enabled through SBF::EnableInstrumentation. Recording threads are spread
+	// over SHARDS shards (a thread always uses the same one), so
+	// that concurrent Check calls do not contend on the same counters; the
+	// shards are merged when a snapshot is taken.
+	class DLL_PUBLIC Instrumentation
+	{
+
+	public:
+		// Number of per-thread shards
+		const static int SHARDS = 16;
+
+		Instrumentation(int AREA_number, int HASH_number);
+		~Instrumentation();
+
+		// Public methods (commented in the instrument.cpp)
+		void RecordInsert(uint64_t ns, int collisions, int hash_calls);
+		void RecordCheck(uint64_t ns, int area, bool early_exit, int hash_calls);
+		void RecordHashCalls(int hash_calls);
+		InstrumentationSnapshot GetSnapshot() const;
+		size_t GetBytes() const;
+
+	private:
+		struct Shard;
+		Shard *shards;
+		int AREA_number;
+		int HASH_number;
+
+		Shard &LocalShard();
+
+		Instrumentation(const Instrumentation &);
+		Instrumentation &operator=(const Instrumentation &);
+	};
+
+
+	// A point-in-time copy of the cell access counts collected by a
+	// CellHeatmap: the sampled SetCell and GetCell calls falling in each
+	// region of the cell array.
+	struct DLL_PUBLIC HeatmapSnapshot
+	{
+		// Size of a region, in bytes and in cells (the last region may be
+		// shorter)
+		int region_bytes;
+		int region_cells;
+		// One in sample_period accesses is counted (per thread)
+		int sample_period;
+		// Sampled accesses per region
+		std::vector<uint64_t> sets;
+		std::vector<uint64_t> gets;
+
+		HeatmapSnapshot();
+
+		uint64_t GetTotal() const;
+		uint64_t GetMax() const;
+		double GetSkew() const;
+		double GetVariation() const;
+		void SaveToDisk(const std::string path) const;
+	};
+
+
+	// Sampled access counts per region of the cell array (e.g. per 4 KiB
+	// page), collected by an SBF when compiled with SBF_INSTRUMENTATION and
+	// enabled through SBF::EnableHeatmap. Regions are counted with relaxed
+	// atomics, so concurrent Check calls may record into the same heatmap.
+	class DLL_PUBLIC CellHeatmap
+	{
+
+	public:
+		CellHeatmap(int cells, int cell_size, int region_bytes, int sample_period);
+		~CellHeatmap();
+
+		// Public methods (commented in the instrument.cpp)
+		void RecordSet(unsigned int index);
+		void RecordGet(unsigned int index);
+		HeatmapSnapshot GetSnapshot() const;
+		size_t GetBytes() const;
+
+	private:
+		struct Region;
+		Region *regions;
+		int region_number;
+		int region_bytes;
+		int region_cells;
+		int sample_period;
+
+		bool Sample() const;
+
+		CellHeatmap(const CellHeatmap &);
+		CellHeatmap &operator=(const CellHeatmap &);
+	};
+
+} //namespace sbf
+
+#endif /* INSTRUMENT_H */
@@ -0,0 +1,223 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define SBF_DLL
+
+#include "memusage.h"
+#include "sbf.h"
+
+#include <mutex>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// The live filters; the set and its mutex are allocated on first use and
+// never released, so that filters destroyed during static destruction can
+// still unregister
+std::mutex &RegistryMutex()
+{
+    static std::mutex *mutex = new std::mutex();
+    return *mutex;
+}
+
+std::set<const SBF*> &Registry()
+{
+    static std::set<const SBF*> *filters = new std::set<const SBF*>();
+    return *filters;
+}
+
+
+#ifdef __linux__
+size_t PageSize()
+{
+    static size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return page;
+}
+#endif
+
+} //namespace
+
+
+/* ***************************** MEMORY USAGE ***************************** */
+
+
+MemoryUsage::MemoryUsage()
+{
+    this->object = 0;
+    this->cells = 0;
+    this->cells_mapped = 0;
+    this->cells_resident = 0;
+    this->salts = 0;
+    this->areas = 0;
+    this->instrumentation = 0;
+    this->recorder = 0;
+    this->cache = 0;
+    this->scratch = 0;
+    this->filters = 0;
+}
+
+
+// Returns the overall allocated bytes (scratch buffers excluded, as they
+// only exist during Insert/Check calls)
+size_t MemoryUsage::GetTotal() const
+{
+    return this->object + this->cells_mapped + this->salts + this->areas + this->instrumentation + this->recorder + this->cache;
+}
+
+
+// Returns the bytes backed by physical memory (as GetTotal, but counting
+// only the resident part of the cell array)
+size_t MemoryUsage::GetResident() const
+{
+    return this->object + this->cells_resident + this->salts + this->areas + this->instrumentation + this->recorder + this->cache;
+}
+
+
+// Adds the usage of another filter (or group of filters)
+void MemoryUsage::Add(const MemoryUsage &other)
+{
+    this->object += other.object;
+    this->cells += other.cells;
+    this->cells_mapped += other.cells_mapped;
+    this->cells_resident += other.cells_resident;
+    this->salts += other.salts;
+    this->areas += other.areas;
+    this->instrumentation += other.instrumentation;
+    this->recorder += other.recorder;
+    this->cache += other.cache;
+    if (other.scratch > this->scratch) this->scratch = other.scratch;
+    this->filters += other.filters;
+}
+
+
+/* ******************************* REGISTRY ******************************* */
+
+
+void MemoryRegistry::Register(const SBF *filter)
+{
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    Registry().insert(filter);
+}
+
+
+void MemoryRegistry::Unregister(const SBF *filter)
+{
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    Registry().erase(filter);
+}
+
+
+// Returns the memory usage summed over all the live filters of the process
+MemoryUsage MemoryRegistry::GetMemoryUsage()
+{
+    MemoryUsage usage;
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    for (std::set<const SBF*>::const_iterator it = Registry().begin(); it != Registry().end(); ++it) {
+        usage.Add((*it)->GetMemoryUsage());
+    }
+    return usage;
+}
+
+
+/* **************************** CELL ALLOCATION **************************** */
+
+
+// Allocates a zero-initialized cell array of the given size
+unsigned char *AllocateCells(size_t size, int &mapped)
+{
+#ifdef __linux__
+    if (size >= CELLS_MAPPING_THRESHOLD) {
+        void *cells = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (cells != MAP_FAILED) {
+            mapped = 1;
+            return (unsigned char *)cells;
+        }
+    }
+#endif
+    mapped = 0;
+    unsigned char *cells = new unsigned char[size];
+    memset(cells, 0, size);
+    return cells;
+}
+
+
+// Releases a cell array allocated by AllocateCells
+void FreeCells(unsigned char *cells, size_t size, int mapped)
+{
+#ifdef __linux__
+    if (mapped) {
+        munmap(cells, size);
+        return;
+    }
+#else
+    (void)size;
+    (void)mapped;
+#endif
+    delete[] cells;
+}
+
+
+// Returns the bytes of address space taken by a cell array
+size_t MappedBytes(size_t size, int mapped)
+{
+#ifdef __linux__
+    if (mapped) return (size + PageSize() - 1) / PageSize() * PageSize();
+#else
+    (void)mapped;
+#endif
+    return size;
+}
+
+
+// Returns the bytes of a cell array backed by physical memory
+size_t ResidentBytes(const unsigned char *cells, size_t size, int mapped)
+{
+#ifdef __linux__
+    if (mapped) {
+        size_t pages = (size + PageSize() - 1) / PageSize();
+        std::vector<unsigned char> resident(pages);
+        if (mincore((void *)cells, size, &resident[0]) != 0) return MappedBytes(size, mapped);
+
+        size_t count = 0;
+        for (size_t p = 0; p < pages; p++) count += resident[p] & 1;
+        return count * PageSize();
+    }
+#else
+    (void)cells;
+    (void)mapped;
+#endif
+    return size;
+}
+
+} //namespace sbf
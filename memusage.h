@@ -0,0 +1,109 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef MEMUSAGE_H
+#define MEMUSAGE_H
+
+// OS specific headers
+#if defined(__MINGW32__) || defined(__MINGW64__)
+#include "win/libexport.h"
+#elif defined(_MSC_VER)
+#include "win/libexport.h"
+#elif __GNUC__
+#include "linux/libexport.h"
+#endif
+
+#include <stddef.h>
+
+
+namespace sbf {
+
+	class SBF;
+
+	// Memory footprint of a filter (or the sum over several filters), in
+	// bytes as requested to the allocator
+	struct DLL_PUBLIC MemoryUsage
+	{
+		// The SBF object itself
+		size_t object;
+		// The cell array (cell_size bytes per cell)
+		size_t cells;
+		// The part of the cell array mapped in the address space (rounded to
+		// pages for demand-zero mappings, equal to cells otherwise)
+		size_t cells_mapped;
+		// The part of the cell array actually backed by physical memory
+		// (pages of demand-zero mappings are only backed once written)
+		size_t cells_resident;
+		// The hash salts (HASH_number x MAX_INPUT_SIZE, plus the row
+		// pointers and the HashSalt object)
+		size_t salts;
+		// The per-area arrays (nine arrays of AREA_number+1 entries)
+		size_t areas;
+		// The instrumentation counters, if enabled
+		size_t instrumentation;
+		// The insertion record, if enabled (see record.h)
+		size_t recorder;
+		// The Check cache, if enabled (see cache.h)
+		size_t cache;
+		// The scratch buffers allocated by each Insert/Check call (at most,
+		// per concurrent call; released when the call returns). For sums
+		// over several filters, the largest value
+		size_t scratch;
+		// The number of filters summed in this structure
+		int filters;
+
+		MemoryUsage();
+
+		size_t GetTotal() const;
+		size_t GetResident() const;
+		void Add(const MemoryUsage &other);
+	};
+
+
+	// Process-wide registry of the live filters, used to aggregate their
+	// memory usage. Filters register themselves on construction and
+	// unregister on destruction.
+	class DLL_PUBLIC MemoryRegistry
+	{
+
+	public:
+		static void Register(const SBF *filter);
+		static void Unregister(const SBF *filter);
+		static MemoryUsage GetMemoryUsage();
+	};
+
+
+	// Cell array allocation: arrays of at least CELLS_MAPPING_THRESHOLD bytes
+	// are mapped as demand-zero pages where supported (so untouched parts of
+	// sparse filters take no physical memory), smaller ones are allocated on
+	// the heap. The returned array is zero-initialized; mapped tells which
+	// kind of allocation was made.
+	const size_t CELLS_MAPPING_THRESHOLD = 1 << 20;
+	DLL_PUBLIC unsigned char *AllocateCells(size_t size, int &mapped);
+	DLL_PUBLIC void FreeCells(unsigned char *cells, size_t size, int mapped);
+	DLL_PUBLIC size_t MappedBytes(size_t size, int mapped);
+	DLL_PUBLIC size_t ResidentBytes(const unsigned char *cells, size_t size, int mapped);
+
+} //namespace sbf
+
+#endif /* MEMUSAGE_H */
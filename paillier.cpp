@@ -0,0 +1,841 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define SBF_DLL
+
+#include "paillier.h"
+#include "parallel.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+const char MAGIC[] = "SBFPAIL1";
+const char PACKED_MAGIC[] = "SBFPAIL2";
+
+
+void WriteUint32(std::ostream &out, unsigned int value)
+{
+    unsigned char bytes[4] = { (unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value };
+    out.write((const char*)bytes, 4);
+}
+
+
+unsigned int ReadUint32(std::istream &in)
+{
+    unsigned char bytes[4];
+    if (!in.read((char*)bytes, 4)) throw std::runtime_error("Truncated encrypted filter header.");
+    return ((unsigned int)bytes[0] << 24) | ((unsigned int)bytes[1] << 16) | ((unsigned int)bytes[2] << 8) | (unsigned int)bytes[3];
+}
+
+
+// Reads a "name;hexadecimal value" line of a key file
+BIGNUM *ReadKeyLine(std::istream &in, const std::string &name)
+{
+    std::string line;
+    if (!std::getline(in, line)) return NULL;
+    if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+    if (line.compare(0, name.size() + 1, name + ";") != 0) throw std::runtime_error("Invalid key file.");
+
+    BIGNUM *value = NULL;
+    if (!BN_hex2bn(&value, line.c_str() + name.size() + 1)) throw std::runtime_error("Invalid key file.");
+    return value;
+}
+
+
+void WriteKeyLine(std::ostream &out, const std::string &name, const BIGNUM *value)
+{
+    char *hex = BN_bn2hex(value);
+    if (hex == NULL) throw std::bad_alloc();
+    out << name << ";" << hex << std::endl;
+    OPENSSL_free(hex);
+}
+
+
+// Writes text onto a file only readable and writable by its owner (on
+// Linux: elsewhere, the file gets the default permissions)
+void WriteOwnerOnly(const std::string &path, const std::string &text)
+{
+#ifdef __linux__
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd < 0) throw std::runtime_error("Unable to open file " + path);
+    // The mode given to open only applies to new files
+    bool ok = fchmod(fd, S_IRUSR | S_IWUSR) == 0;
+    for (size_t written = 0; ok && written < text.size();) {
+        ssize_t n = write(fd, text.data() + written, text.size() - written);
+        if (n < 0) ok = false;
+        else written += (size_t)n;
+    }
+    if (close(fd) != 0) ok = false;
+    if (!ok) throw std::runtime_error("Unable to write file " + path);
+#else
+    std::ofstream myfile(path.c_str(), std::ios::binary);
+    if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+    myfile << text;
+    if (!myfile) throw std::runtime_error("Unable to write file " + path);
+#endif
+}
+
+} //namespace
+
+
+/* ****************************** KEY METHODS ****************************** */
+
+
+PaillierKey::PaillierKey()
+{
+    this->n = NULL;
+    this->n2 = NULL;
+    this->g = NULL;
+    this->p = NULL;
+    this->q = NULL;
+    this->p2 = NULL;
+    this->q2 = NULL;
+    this->ep = NULL;
+    this->eq = NULL;
+    this->q2_inverse = NULL;
+    this->lambda = NULL;
+    this->mu = NULL;
+}
+
+
+PaillierKey::~PaillierKey()
+{
+    this->Clear();
+}
+
+
+// Frees all the components of the key
+void PaillierKey::Clear()
+{
+    BN_free(this->n);
+    BN_free(this->n2);
+    BN_free(this->g);
+    BN_clear_free(this->p);
+    BN_clear_free(this->q);
+    BN_clear_free(this->p2);
+    BN_clear_free(this->q2);
+    BN_clear_free(this->ep);
+    BN_clear_free(this->eq);
+    BN_clear_free(this->q2_inverse);
+    BN_clear_free(this->lambda);
+    BN_clear_free(this->mu);
+    this->n = NULL;
+    this->n2 = NULL;
+    this->g = NULL;
+    this->p = NULL;
+    this->q = NULL;
+    this->p2 = NULL;
+    this->q2 = NULL;
+    this->ep = NULL;
+    this->eq = NULL;
+    this->q2_inverse = NULL;
+    this->lambda = NULL;
+    this->mu = NULL;
+}
+
+
+// Derives n^2 and g = n + 1 from the modulus
+void PaillierKey::SetModulus()
+{
+    BN_CTX *ctx = BN_CTX_new();
+    this->n2 = BN_new();
+    this->g = BN_new();
+    bool ok = ctx != NULL && this->n2 != NULL && this->g != NULL &&
+        BN_sqr(this->n2, this->n, ctx) && BN_copy(this->g, this->n) != NULL && BN_add_word(this->g, 1);
+    BN_CTX_free(ctx);
+    if (!ok) throw std::bad_alloc();
+}
+
+
+// Sets the private part from the factors of n (taking ownership of them)
+// and derives the decryption values, lambda = lcm(p-1, q-1) and
+// mu = lambda^-1 mod n, and the CRT values used to compute randomizers:
+// the exponents n mod p(p-1) and n mod q(q-1) and (q^2)^-1 mod p^2
+void PaillierKey::SetPrimes(BIGNUM *p, BIGNUM *q)
+{
+    this->p = p;
+    this->q = q;
+    this->p2 = BN_new();
+    this->q2 = BN_new();
+    this->ep = BN_new();
+    this->eq = BN_new();
+    this->q2_inverse = BN_new();
+    this->lambda = BN_new();
+    this->mu = BN_new();
+
+    BN_CTX *ctx = BN_CTX_new();
+    BIGNUM *p1 = BN_new();
+    BIGNUM *q1 = BN_new();
+    BIGNUM *gcd = BN_new();
+    bool ok = ctx && p1 && q1 && gcd && this->p2 && this->q2 && this->ep && this->eq && this->q2_inverse && this->lambda && this->mu &&
+        BN_sub(p1, p, BN_value_one()) && BN_sub(q1, q, BN_value_one()) && BN_gcd(gcd, p1, q1, ctx) &&
+        BN_mul(this->lambda, p1, q1, ctx) && BN_div(this->lambda, NULL, this->lambda, gcd, ctx) &&
+        BN_mod_inverse(this->mu, this->lambda, this->n, ctx) != NULL &&
+        BN_sqr(this->p2, p, ctx) && BN_sqr(this->q2, q, ctx) &&
+        BN_mul(p1, p1, p, ctx) && BN_mod(this->ep, this->n, p1, ctx) &&
+        BN_mul(q1, q1, q, ctx) && BN_mod(this->eq, this->n, q1, ctx) &&
+        BN_mod_inverse(this->q2_inverse, this->q2, this->p2, ctx) != NULL;
+
+    BN_clear_free(p1);
+    BN_clear_free(q1);
+    BN_free(gcd);
+    BN_CTX_free(ctx);
+    if (!ok) {
+        this->Clear();
+        throw std::runtime_error("Invalid Paillier key.");
+    }
+}
+
+
+// Generates a new key pair with a modulus n of the given size in bits
+// (at least 1024; 2048 or more is recommended)
+void PaillierKey::Generate(int bits)
+{
+    if (bits < 1024 || bits % 2 != 0) throw std::invalid_argument("Invalid Paillier modulus size.");
+
+    this->Clear();
+
+    BN_CTX *ctx = BN_CTX_new();
+    BIGNUM *p = BN_new();
+    BIGNUM *q = BN_new();
+    this->n = BN_new();
+
+    bool ok = ctx && p && q && this->n;
+    // p and q have the same size, so that gcd(n, (p-1)(q-1)) = 1
+    while (ok) {
+        ok = BN_generate_prime_ex(p, bits / 2, 0, NULL, NULL, NULL) && BN_generate_prime_ex(q, bits / 2, 0, NULL, NULL, NULL) &&
+            BN_mul(this->n, p, q, ctx);
+        if (ok && BN_cmp(p, q) != 0 && BN_num_bits(this->n) == bits) break;
+    }
+    BN_CTX_free(ctx);
+
+    if (!ok) {
+        BN_clear_free(p);
+        BN_clear_free(q);
+        this->Clear();
+        throw std::runtime_error("Unable to generate the Paillier key.");
+    }
+
+    this->SetModulus();
+    this->SetPrimes(p, q);
+}
+
+
+// Sets a public key from its modulus n (big-endian, bytes bytes), dropping
+// any private part
+void PaillierKey::SetPublic(const unsigned char *modulus, int bytes)
+{
+    BIGNUM *n = BN_bin2bn(modulus, bytes, NULL);
+    if (n == NULL) throw std::bad_alloc();
+    if (BN_num_bits(n) < 1024) {
+        BN_free(n);
+        throw std::invalid_argument("Invalid Paillier modulus size.");
+    }
+
+    this->Clear();
+    this->n = n;
+    this->SetModulus();
+}
+
+
+// Writes the key onto a file (path), one "name;hexadecimal value" line per
+// component: n, then p and q if include_private is set. A file holding the
+// private part is created with mode 0600 (an existing one is set to it).
+void PaillierKey::SaveToDisk(const std::string path, bool include_private) const
+{
+    if (this->n == NULL) throw std::logic_error("Empty Paillier key.");
+    if (include_private && !this->HasPrivate()) throw std::logic_error("The Paillier key has no private part.");
+
+    if (!include_private) {
+        std::ofstream myfile(path.c_str());
+        if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+        WriteKeyLine(myfile, "n", this->n);
+        return;
+    }
+
+    std::ostringstream text;
+    WriteKeyLine(text, "n", this->n);
+    WriteKeyLine(text, "p", this->p);
+    WriteKeyLine(text, "q", this->q);
+    WriteOwnerOnly(path, text.str());
+}
+
+
+// Reads a key written by SaveToDisk (with or without its private part).
+// As with Generate and SetPublic, the modulus must have at least 1024 bits,
+// and the private part must factor it.
+void PaillierKey::LoadFromDisk(const std::string path)
+{
+    std::ifstream myfile(path.c_str());
+    if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+
+    BIGNUM *n = ReadKeyLine(myfile, "n");
+    if (n == NULL) throw std::runtime_error("Invalid key file.");
+    BIGNUM *p = NULL;
+    BIGNUM *q = NULL;
+    BIGNUM *product = NULL;
+    BN_CTX *ctx = NULL;
+    try {
+        if (BN_num_bits(n) < 1024) throw std::runtime_error("Invalid key file.");
+        p = ReadKeyLine(myfile, "p");
+        if (p != NULL) {
+            q = ReadKeyLine(myfile, "q");
+            if (q == NULL) throw std::runtime_error("Invalid key file.");
+
+            ctx = BN_CTX_new();
+            product = BN_new();
+            if (ctx == NULL || product == NULL || !BN_mul(product, p, q, ctx)) throw std::bad_alloc();
+            if (BN_cmp(product, n) != 0 || BN_is_one(p) || BN_is_one(q)) throw std::runtime_error("Invalid key file.");
+            BN_free(product);
+            BN_CTX_free(ctx);
+        }
+    }
+    catch (...) {
+        BN_free(n);
+        BN_clear_free(p);
+        BN_clear_free(q);
+        BN_free(product);
+        BN_CTX_free(ctx);
+        throw;
+    }
+
+    this->Clear();
+    this->n = n;
+    this->SetModulus();
+    if (p != NULL) this->SetPrimes(p, q);
+}
+
+
+// Returns true if the key can decrypt
+bool PaillierKey::HasPrivate() const
+{
+    return this->lambda != NULL && this->mu != NULL;
+}
+
+
+// Returns the size of the modulus n in bytes
+int PaillierKey::GetModulusBytes() const
+{
+    return (this->n == NULL) ? 0 : BN_num_bytes(this->n);
+}
+
+
+// Returns the size of a ciphertext (a number modulo n^2) in bytes
+int PaillierKey::GetCiphertextBytes() const
+{
+    return 2 * this->GetModulusBytes();
+}
+
+
+const BIGNUM *PaillierKey::GetN() const
+{
+    return this->n;
+}
+
+
+const BIGNUM *PaillierKey::GetN2() const
+{
+    return this->n2;
+}
+
+
+const BIGNUM *PaillierKey::GetG() const
+{
+    return this->g;
+}
+
+
+// Sets up the Montgomery contexts used by Randomizer: for n^2, and for p^2
+// and q^2 if the key has its private part (otherwise they are left unset)
+bool PaillierKey::SetMontgomery(BN_MONT_CTX *mont_n2, BN_MONT_CTX *mont_p2, BN_MONT_CTX *mont_q2, BN_CTX *ctx) const
+{
+    if (!BN_MONT_CTX_set(mont_n2, this->n2, ctx)) return false;
+    if (!this->HasPrivate()) return true;
+    return BN_MONT_CTX_set(mont_p2, this->p2, ctx) && BN_MONT_CTX_set(mont_q2, this->q2, ctx);
+}
+
+
+// Computes a fresh randomizer rn = r^n mod n^2, with r uniform in [1, n).
+// With the private part, r^n is computed modulo p^2 and q^2 (where the
+// exponent reduces to half size) and recombined. The Montgomery contexts
+// must have been set up by SetMontgomery, and belong to the calling thread.
+bool PaillierKey::Randomizer(BIGNUM *rn, BN_CTX *ctx, BN_MONT_CTX *mont_n2, BN_MONT_CTX *mont_p2, BN_MONT_CTX *mont_q2) const
+{
+    BN_CTX_start(ctx);
+    BIGNUM *r = BN_CTX_get(ctx);
+    BIGNUM *xp = BN_CTX_get(ctx);
+    BIGNUM *xq = BN_CTX_get(ctx);
+    bool ok = xq != NULL;
+
+    while (ok) {
+        ok = BN_rand_range(r, this->n);
+        if (!BN_is_zero(r)) break;
+    }
+
+    if (!this->HasPrivate()) {
+        ok = ok && BN_mod_exp_mont(rn, r, this->n, this->n2, ctx, mont_n2);
+    }
+    else {
+        // rn = xq + q^2 * ((xp - xq) * (q^2)^-1 mod p^2)
+        ok = ok && BN_mod_exp_mont(xp, r, this->ep, this->p2, ctx, mont_p2) && BN_mod_exp_mont(xq, r, this->eq, this->q2, ctx, mont_q2) &&
+            BN_mod_sub(xp, xp, xq, this->p2, ctx) && BN_mod_mul(xp, xp, this->q2_inverse, this->p2, ctx) &&
+            BN_mul(rn, xp, this->q2, ctx) && BN_add(rn, rn, xq);
+    }
+
+    BN_CTX_end(ctx);
+    return ok;
+}
+
+
+// Decrypts c into m: m = L(c^lambda mod n^2) * mu mod n, with
+// L(x) = (x - 1) / n
+void PaillierKey::Decrypt(BIGNUM *m, const BIGNUM *c, BN_CTX *ctx) const
+{
+    if (!this->HasPrivate()) throw std::logic_error("The Paillier key has no private part.");
+
+    BN_CTX_start(ctx);
+    BIGNUM *x = BN_CTX_get(ctx);
+    bool ok = x != NULL && BN_mod_exp(x, c, this->lambda, this->n2, ctx) && BN_sub_word(x, 1) &&
+        BN_div(x, NULL, x, this->n, ctx) && BN_mod_mul(m, x, this->mu, this->n, ctx);
+    BN_CTX_end(ctx);
+
+    if (!ok) throw std::runtime_error("Paillier decryption failed.");
+}
+
+
+/* **************************** HEADER METHODS ***************************** */
+
+
+EncryptedHeader::EncryptedHeader()
+{
+    this->bit_mapping = 0;
+    this->HASH_family = 0;
+    this->HASH_number = 0;
+    this->AREA_number = 0;
+    this->slot_bits = 0;
+    this->guard_bits = 0;
+    this->slots = 1;
+}
+
+
+// Returns the number of cells of the filter
+long long EncryptedHeader::GetCells() const
+{
+    return 1LL << this->bit_mapping;
+}
+
+
+// Returns the number of ciphertexts following the header
+long long EncryptedHeader::GetCiphertexts() const
+{
+    return (this->GetCells() + this->slots - 1) / this->slots;
+}
+
+
+// Returns the size of each ciphertext in bytes
+int EncryptedHeader::GetCiphertextBytes() const
+{
+    return 2 * (int)this->modulus.size();
+}
+
+
+// Returns the label of the cell at index, given the decrypted plaintext of
+// its ciphertext (the one at index / slots), or -1 if the slot does not hold
+// a valid label
+int EncryptedHeader::ExtractCell(const BIGNUM *plaintext, unsigned int index) const
+{
+    BIGNUM *slot = BN_dup(plaintext);
+    if (slot == NULL) throw std::bad_alloc();
+
+    if (this->slots > 1) {
+        BN_rshift(slot, slot, (int)(index % this->slots) * this->slot_bits);
+        BN_mask_bits(slot, this->slot_bits);
+    }
+
+    int area = (BN_num_bits(slot) > 31) ? -1 : (int)BN_get_word(slot);
+    BN_free(slot);
+    return (area > this->AREA_number) ? -1 : area;
+}
+
+
+// Returns the number of bits needed by the area labels of a filter
+int EncryptedHeader::LabelBits(int AREA_number)
+{
+    int bits = 1;
+    while ((AREA_number >> bits) != 0) bits++;
+    return bits;
+}
+
+
+void EncryptedHeader::Write(std::ostream &out) const
+{
+    out.write((this->slots > 1) ? PACKED_MAGIC : MAGIC, 8);
+    WriteUint32(out, (unsigned int)this->bit_mapping);
+    WriteUint32(out, (unsigned int)this->HASH_family);
+    WriteUint32(out, (unsigned int)this->HASH_number);
+    WriteUint32(out, (unsigned int)this->AREA_number);
+    if (this->slots > 1) {
+        WriteUint32(out, (unsigned int)this->slot_bits);
+        WriteUint32(out, (unsigned int)this->guard_bits);
+        WriteUint32(out, (unsigned int)this->slots);
+    }
+    WriteUint32(out, (unsigned int)this->modulus.size());
+    out.write((const char*)&this->modulus[0], this->modulus.size());
+}
+
+
+void EncryptedHeader::Read(std::istream &in)
+{
+    char magic[8];
+    if (!in.read(magic, 8)) throw std::runtime_error("Not an encrypted filter.");
+    bool packed = std::string(magic, 8) == std::string(PACKED_MAGIC, 8);
+    if (!packed && std::string(magic, 8) != std::string(MAGIC, 8)) throw std::runtime_error("Not an encrypted filter.");
+
+    this->bit_mapping = (int)ReadUint32(in);
+    this->HASH_family = (int)ReadUint32(in);
+    this->HASH_number = (int)ReadUint32(in);
+    this->AREA_number = (int)ReadUint32(in);
+    this->slot_bits = 0;
+    this->guard_bits = 0;
+    this->slots = 1;
+    if (packed) {
+        this->slot_bits = (int)ReadUint32(in);
+        this->guard_bits = (int)ReadUint32(in);
+        this->slots = (int)ReadUint32(in);
+    }
+    unsigned int bytes = ReadUint32(in);
+    if (this->bit_mapping < 1 || this->bit_mapping > SBF::MAX_BIT_MAPPING || bytes < 128 || bytes > 8192) {
+        throw std::runtime_error("Invalid encrypted filter header.");
+    }
+    if (packed && (this->slots < 2 || this->guard_bits < 0 || this->slot_bits != EncryptedHeader::LabelBits(this->AREA_number) + this->guard_bits ||
+        (long long)this->slots * this->slot_bits >= 8LL * bytes)) {
+        throw std::runtime_error("Invalid encrypted filter header.");
+    }
+
+    this->modulus.resize(bytes);
+    if (!in.read((char*)&this->modulus[0], bytes)) throw std::runtime_error("Truncated encrypted filter header.");
+}
+
+
+/* **************************** CONTEXT METHODS **************************** */
+
+
+PaillierContext::PaillierContext(const PaillierKey &key)
+{
+    this->key = &key;
+    this->ctx = BN_CTX_new();
+    this->mont_n2 = BN_MONT_CTX_new();
+    this->mont_p2 = BN_MONT_CTX_new();
+    this->mont_q2 = BN_MONT_CTX_new();
+    this->c = BN_new();
+    if (this->ctx == NULL || this->mont_n2 == NULL || this->mont_p2 == NULL || this->mont_q2 == NULL || this->c == NULL ||
+        !key.SetMontgomery(this->mont_n2, this->mont_p2, this->mont_q2, this->ctx)) {
+        this->Free();
+        throw std::bad_alloc();
+    }
+}
+
+
+PaillierContext::~PaillierContext()
+{
+    this->Free();
+}
+
+
+void PaillierContext::Free()
+{
+    BN_free(this->c);
+    BN_MONT_CTX_free(this->mont_q2);
+    BN_MONT_CTX_free(this->mont_p2);
+    BN_MONT_CTX_free(this->mont_n2);
+    BN_CTX_free(this->ctx);
+    this->c = NULL;
+    this->mont_q2 = NULL;
+    this->mont_p2 = NULL;
+    this->mont_n2 = NULL;
+    this->ctx = NULL;
+}
+
+
+// Computes a fresh randomizer r^n mod n^2 into out, as a big-endian number
+// of bytes bytes
+bool PaillierContext::Randomizer(unsigned char *out, int bytes)
+{
+    if (!this->key->Randomizer(this->c, this->ctx, this->mont_n2, this->mont_p2, this->mont_q2)) return false;
+    return BN_bn2binpad(this->c, out, bytes) == bytes;
+}
+
+
+// Multiplies the ciphertext in buffer (big-endian, bytes bytes) by factor,
+// modulo n^2
+bool PaillierContext::Multiply(unsigned char *buffer, int bytes, const BIGNUM *factor)
+{
+    if (BN_bin2bn(buffer, bytes, this->c) == NULL) return false;
+    if (!BN_mod_mul(this->c, this->c, factor, this->key->GetN2(), this->ctx)) return false;
+    return BN_bn2binpad(this->c, buffer, bytes) == bytes;
+}
+
+
+/* ************************ RANDOMNESS POOL METHODS ************************ */
+
+
+RandomnessPool::RandomnessPool(const PaillierKey &key, int threads) : next(0)
+{
+    this->key = &key;
+    this->threads = ThreadCount(threads);
+    this->size = 0;
+}
+
+
+// Computes count more randomizers in parallel and adds them to the pool
+void RandomnessPool::Precompute(long long count)
+{
+    if (count <= 0) return;
+
+    int bytes = this->key->GetCiphertextBytes();
+
+    // Drops the randomizers already handed out before growing the pool
+    long long used = this->next.load();
+    if (used > this->size) used = this->size;
+    this->values.erase(this->values.begin(), this->values.begin() + (size_t)(used * bytes));
+    this->size -= used;
+    this->next = 0;
+    this->values.resize((size_t)((this->size + count) * bytes));
+
+    unsigned char *out = &this->values[(size_t)(this->size * bytes)];
+    std::atomic<bool> failed(false);
+    ParallelFor(this->threads, count, [&](int, long long begin, long long end) {
+        try {
+            PaillierContext context(*this->key);
+            for (long long i = begin; i < end && !failed; i++) {
+                if (!context.Randomizer(out + i * bytes, bytes)) failed = true;
+            }
+        }
+        catch (...) {
+            failed = true;
+        }
+    });
+
+    if (failed) {
+        this->values.resize((size_t)(this->size * bytes));
+        throw std::runtime_error("Unable to precompute the Paillier randomness.");
+    }
+    this->size += count;
+}
+
+
+// Returns the number of randomizers not yet handed out
+long long RandomnessPool::GetSize() const
+{
+    long long used = this->next.load();
+    return (used >= this->size) ? 0 : this->size - used;
+}
+
+
+// Hands out up to count consecutive randomizers (taken is set to their
+// number, possibly 0). Returns a pointer to the first one, or NULL if the
+// pool is empty.
+const unsigned char *RandomnessPool::Take(long long count, long long &taken)
+{
+    taken = 0;
+    if (count <= 0 || this->next.load(std::memory_order_relaxed) >= this->size) return NULL;
+
+    long long first = this->next.fetch_add(count);
+    if (first >= this->size) return NULL;
+
+    taken = (first + count > this->size) ? this->size - first : count;
+    return &this->values[(size_t)(first * this->key->GetCiphertextBytes())];
+}
+
+
+/* *************************** ENCRYPTOR METHODS *************************** */
+
+
+PaillierEncryptor::PaillierEncryptor(const PaillierKey &key, int threads) : pool(key, threads)
+{
+    if (key.GetN() == NULL) throw std::invalid_argument("Empty Paillier key.");
+
+    this->key = &key;
+    this->threads = ThreadCount(threads);
+    this->guard_bits = -1;
+}
+
+
+// Computes count randomizers r^n mod n^2 in parallel and adds them to the
+// pool, to be used by the next encryptions instead of fresh ones
+void PaillierEncryptor::PrecomputeRandomness(long long count)
+{
+    this->pool.Precompute(count);
+}
+
+
+// Returns the number of precomputed randomizers not yet used
+long long PaillierEncryptor::GetPoolSize() const
+{
+    return this->pool.GetSize();
+}
+
+
+// Enables the packed format (see EncryptedHeader), with guard_bits guard bits
+// per slot, or disables it if guard_bits is negative. Without guard bits
+// the cells are packed most densely, but the server cannot mask the cells
+// sharing a ciphertext with the requested one, so that the key holder
+// decrypts all of them; with g guard bits, masked cells are hidden up to a
+// statistical distance of 2^-(g-1) each.
+void PaillierEncryptor::SetPacking(int guard_bits)
+{
+    this->guard_bits = guard_bits;
+}
+
+
+// Encrypts every cell of the filter onto a file (path)
+void PaillierEncryptor::Encrypt(const SBF *filter, const std::string &path)
+{
+    std::ofstream myfile(path.c_str(), std::ios::binary);
+    if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+    this->Encrypt(filter, myfile);
+}
+
+
+// Encrypts every cell of the filter onto a stream, in the encrypted filter
+// format (see EncryptedHeader). Chunks of CHUNK_CELLS ciphertexts are
+// encrypted by all the threads, while a writer thread streams out the
+// previous chunk.
+void PaillierEncryptor::Encrypt(const SBF *filter, std::ostream &out)
+{
+    const PaillierKey &key = *this->key;
+    int bytes = key.GetCiphertextBytes();
+    int AREA_number = filter->GetAreaNumber();
+
+    EncryptedHeader header;
+    header.bit_mapping = filter->GetBitMapping();
+    header.HASH_family = filter->GetHashFamily();
+    header.HASH_number = filter->GetHashNumber();
+    header.AREA_number = AREA_number;
+    header.modulus.resize(key.GetModulusBytes());
+    BN_bn2binpad(key.GetN(), &header.modulus[0], (int)header.modulus.size());
+    if (this->guard_bits >= 0) {
+        // Plaintexts stay below 2^(bits(n) - 1) < n
+        header.guard_bits = this->guard_bits;
+        header.slot_bits = EncryptedHeader::LabelBits(AREA_number) + this->guard_bits;
+        header.slots = (BN_num_bits(key.GetN()) - 1) / header.slot_bits;
+        if (header.slots < 2) throw std::invalid_argument("Too many guard bits for the Paillier modulus.");
+        if (header.slots > header.GetCells()) header.slots = (int)header.GetCells();
+    }
+    header.Write(out);
+    const int slots = header.slots;
+    const int slot_bits = header.slot_bits;
+
+    // Fixed-base table of g^m mod n^2 for every area label m (one cell per
+    // ciphertext)
+    std::vector<BIGNUM*> powers(AREA_number + 1, (BIGNUM*)NULL);
+    BN_CTX *ctx = BN_CTX_new();
+    bool ok = ctx != NULL;
+    for (int m = 0; ok && slots == 1 && m <= AREA_number; m++) {
+        powers[m] = BN_new();
+        ok = powers[m] != NULL && ((m == 0) ? BN_one(powers[m]) : BN_mod_mul(powers[m], powers[m - 1], key.GetG(), key.GetN2(), ctx));
+    }
+    BN_CTX_free(ctx);
+
+    long long cells = header.GetCells();
+    long long ciphertexts = header.GetCiphertexts();
+    std::vector<int> areas((size_t)PaillierEncryptor::CHUNK_CELLS * slots);
+    std::vector<unsigned char> buffers[2];
+    buffers[0].resize((size_t)PaillierEncryptor::CHUNK_CELLS * bytes);
+    buffers[1].resize((size_t)PaillierEncryptor::CHUNK_CELLS * bytes);
+    std::thread writer;
+    std::atomic<bool> failed(!ok);
+
+    for (long long first = 0, chunk = 0; first < ciphertexts && !failed; first += PaillierEncryptor::CHUNK_CELLS, chunk++) {
+        int count = (int)((ciphertexts - first < PaillierEncryptor::CHUNK_CELLS) ? ciphertexts - first : PaillierEncryptor::CHUNK_CELLS);
+        unsigned char *buffer = &buffers[chunk % 2][0];
+        long long first_cell = first * slots;
+        long long chunk_cells = (cells - first_cell < (long long)count * slots) ? cells - first_cell : (long long)count * slots;
+        filter->ReadCells((unsigned int)first_cell, (int)chunk_cells, &areas[0]);
+        for (long long i = chunk_cells; i < (long long)count * slots; i++) areas[i] = 0;
+
+        // The first ciphertexts of the chunk take the pooled randomizers, if
+        // any
+        long long pooled;
+        const unsigned char *randomizers = this->pool.Take(count, pooled);
+        if (pooled > 0) memcpy(buffer, randomizers, (size_t)(pooled * bytes));
+
+        ParallelFor(this->threads, count, [&](int, long long begin, long long end) {
+            try {
+                PaillierContext context(key);
+                BIGNUM *m = BN_new();
+                if (m == NULL) throw std::bad_alloc();
+                for (long long i = begin; i < end && !failed; i++) {
+                    unsigned char *c = buffer + i * bytes;
+                    if (i >= pooled && !context.Randomizer(c, bytes)) failed = true;
+
+                    if (slots == 1) {
+                        int area = areas[i];
+                        if (area > 0 && area <= AREA_number && !context.Multiply(c, bytes, powers[area])) failed = true;
+                        continue;
+                    }
+
+                    // m = sum of the cells shifted to their slots, g^m = 1 + m*n
+                    bool empty = true;
+                    BN_zero(m);
+                    for (int s = slots - 1; s >= 0; s--) {
+                        int area = areas[i * slots + s];
+                        if (!BN_lshift(m, m, slot_bits) || (area > 0 && area <= AREA_number && !BN_add_word(m, (BN_ULONG)area))) failed = true;
+                        if (area > 0) empty = false;
+                    }
+                    if (!empty && !(BN_mul(m, m, key.GetN(), context.ctx) && BN_add_word(m, 1) && context.Multiply(c, bytes, m))) failed = true;
+                }
+                BN_free(m);
+            }
+            catch (...) {
+                failed = true;
+            }
+        });
+
+        if (writer.joinable()) writer.join();
+        writer = std::thread([&out, buffer, count, bytes]() {
+            out.write((const char*)buffer, (std::streamsize)count * bytes);
+        });
+    }
+    if (writer.joinable()) writer.join();
+
+    for (int m = 0; m <= AREA_number; m++) BN_free(powers[m]);
+
+    if (failed) throw std::runtime_error("Paillier encryption failed.");
+    if (!out.good()) throw std::runtime_error("Unable to write the encrypted filter.");
+}
+
+} //namespace sbf
@@ -0,0 +1,222 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef PAILLIER_H
+#define PAILLIER_H
+
+#include "sbf.h"
+
+#include <openssl/bn.h>
+
+#include <atomic>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace sbf {
+
+	// A Paillier key pair (or only its public part), with generator
+	// g = n + 1. The private part (the factors p and q of n) is needed to
+	// decrypt, and also speeds up encryption: with it, r^n mod n^2 is
+	// computed modulo p^2 and q^2 with half-size exponents and recombined
+	// (CRT).
+	class DLL_PUBLIC PaillierKey
+	{
+
+	private:
+		BIGNUM *n;
+		BIGNUM *n2;
+		BIGNUM *g;
+		// Private part and the values derived from it
+		BIGNUM *p;
+		BIGNUM *q;
+		BIGNUM *p2;
+		BIGNUM *q2;
+		BIGNUM *ep;
+		BIGNUM *eq;
+		BIGNUM *q2_inverse;
+		BIGNUM *lambda;
+		BIGNUM *mu;
+
+		// Private methods (commented in the paillier.cpp)
+		void SetModulus();
+		void SetPrimes(BIGNUM *p, BIGNUM *q);
+		void Clear();
+
+		PaillierKey(const PaillierKey &);
+		PaillierKey &operator=(const PaillierKey &);
+
+	public:
+		PaillierKey();
+		~PaillierKey();
+
+		// Public methods (commented in the paillier.cpp)
+		void Generate(int bits);
+		void SetPublic(const unsigned char *modulus, int bytes);
+		void SaveToDisk(const std::string path, bool include_private) const;
+		void LoadFromDisk(const std::string path);
+		bool HasPrivate() const;
+		int GetModulusBytes() const;
+		int GetCiphertextBytes() const;
+		const BIGNUM *GetN() const;
+		const BIGNUM *GetN2() const;
+		const BIGNUM *GetG() const;
+		bool Randomizer(BIGNUM *rn, BN_CTX *ctx, BN_MONT_CTX *mont_n2, BN_MONT_CTX *mont_p2, BN_MONT_CTX *mont_q2) const;
+		bool SetMontgomery(BN_MONT_CTX *mont_n2, BN_MONT_CTX *mont_p2, BN_MONT_CTX *mont_q2, BN_CTX *ctx) const;
+		void Decrypt(BIGNUM *m, const BIGNUM *c, BN_CTX *ctx) const;
+	};
+
+
+	// Header of an encrypted filter file. The file starts with a magic,
+	// followed by the filter settings and the modulus n (all integers
+	// big-endian):
+	//   "SBFPAIL1" (one cell per ciphertext) or "SBFPAIL2" (packed)
+	//   uint32 bit_mapping, HASH_family, HASH_number, AREA_number
+	//   uint32 slot_bits, guard_bits, slots (packed format only)
+	//   uint32 modulus_bytes, followed by n (modulus_bytes bytes)
+	// and then by the ciphertexts, each as a big-endian number of
+	// 2*modulus_bytes bytes. In the packed format, ciphertext j encrypts the
+	// cells j*slots to (j+1)*slots - 1, cell j*slots + s being stored in the
+	// bits from s*slot_bits of the plaintext; each slot has guard_bits bits
+	// more than needed by the highest area label, to keep masked slots from
+	// overflowing (see EncryptedSBF). The hash salts are not part of the file.
+	struct DLL_PUBLIC EncryptedHeader
+	{
+		int bit_mapping;
+		int HASH_family;
+		int HASH_number;
+		int AREA_number;
+		int slot_bits;
+		int guard_bits;
+		int slots;
+		std::vector<unsigned char> modulus;
+
+		EncryptedHeader();
+
+		long long GetCells() const;
+		long long GetCiphertexts() const;
+		int GetCiphertextBytes() const;
+		int ExtractCell(const BIGNUM *plaintext, unsigned int index) const;
+		static int LabelBits(int AREA_number);
+		void Write(std::ostream &out) const;
+		void Read(std::istream &in);
+	};
+
+
+	// Big number arithmetic state owned by a single thread: a scratch
+	// context and the Montgomery contexts for n^2 (and for p^2 and q^2 with
+	// a private key). Montgomery contexts are set up once per thread and
+	// never shared, so that no locking is needed on the hot paths.
+	struct DLL_PUBLIC PaillierContext
+	{
+		const PaillierKey *key;
+		BN_CTX *ctx;
+		BN_MONT_CTX *mont_n2;
+		BN_MONT_CTX *mont_p2;
+		BN_MONT_CTX *mont_q2;
+		BIGNUM *c;
+
+		PaillierContext(const PaillierKey &key);
+		~PaillierContext();
+
+		bool Randomizer(unsigned char *out, int bytes);
+		bool Multiply(unsigned char *buffer, int bytes, const BIGNUM *factor);
+
+	private:
+		void Free();
+
+		PaillierContext(const PaillierContext &);
+		PaillierContext &operator=(const PaillierContext &);
+	};
+
+
+	// A pool of randomizers r^n mod n^2 computed ahead of time by multiple
+	// threads (e.g. while the filter is being built, or while a server is
+	// idle), so that encryption and re-randomization only pay for them when
+	// the pool runs dry. Each randomizer is handed out once. Take may be
+	// called concurrently, but not together with Precompute.
+	class DLL_PUBLIC RandomnessPool
+	{
+
+	private:
+		const PaillierKey *key;
+		int threads;
+		std::vector<unsigned char> values;
+		long long size;
+		std::atomic<long long> next;
+
+		RandomnessPool(const RandomnessPool &);
+		RandomnessPool &operator=(const RandomnessPool &);
+
+	public:
+		RandomnessPool(const PaillierKey &key, int threads);
+
+		// Public methods (commented in the paillier.cpp)
+		void Precompute(long long count);
+		long long GetSize() const;
+		const unsigned char *Take(long long count, long long &taken);
+	};
+
+
+	// Encrypts every cell of a filter with Paillier, streaming the
+	// ciphertexts to the encrypted filter format (see EncryptedHeader).
+	// Encrypting a cell holding label m takes g^m, read from a table built
+	// once for all the area labels, times a fresh r^n mod n^2. The latter
+	// is the expensive part: it is computed by all the threads, chunk after
+	// chunk while the previous chunk is written out, or taken from the pool
+	// filled by PrecomputeRandomness.
+	// With packing enabled (SetPacking), each plaintext holds as many cells
+	// as fit in the modulus, so that the number of exponentiations and the
+	// size of the output drop by the same factor; g^m is then computed as
+	// 1 + m*n mod n^2.
+	class DLL_PUBLIC PaillierEncryptor
+	{
+
+	private:
+		const PaillierKey *key;
+		int threads;
+		int guard_bits;
+		RandomnessPool pool;
+
+		PaillierEncryptor(const PaillierEncryptor &);
+		PaillierEncryptor &operator=(const PaillierEncryptor &);
+
+	public:
+		// Number of cells encrypted (and written) per chunk
+		const static int CHUNK_CELLS = 4096;
+
+		PaillierEncryptor(const PaillierKey &key, int threads);
+
+		// Public methods (commented in the paillier.cpp)
+		void PrecomputeRandomness(long long count);
+		long long GetPoolSize() const;
+		void SetPacking(int guard_bits);
+		void Encrypt(const SBF *filter, const std::string &path);
+		void Encrypt(const SBF *filter, std::ostream &out);
+	};
+
+} //namespace sbf
+
+#endif /* PAILLIER_H */
@@ -0,0 +1,227 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define SBF_DLL
+
+#include "parallel.h"
+
+#include <exception>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+std::atomic<Executor*> current_executor(NULL);
+
+// The pool running the current thread, and the worker number within it
+thread_local const void *worker_pool = NULL;
+thread_local int worker_number = -1;
+
+} //namespace
+
+
+// The parts of a Run call still to complete, and the first exception
+// thrown by one of them
+struct WorkStealingPool::Group
+{
+    const std::function<void(int)> *task;
+    std::atomic<int> pending;
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+};
+
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+void SetExecutor(Executor *executor)
+{
+    current_executor.store(executor);
+}
+
+
+Executor &GetExecutor()
+{
+    Executor *executor = current_executor.load();
+    if (executor != NULL) return *executor;
+
+    static WorkStealingPool pool(0);
+    return pool;
+}
+
+
+// threads = 0 uses the available hardware threads
+WorkStealingPool::WorkStealingPool(int threads, const std::function<void(int)> &on_start)
+{
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+
+    this->queued = 0;
+    this->stop = false;
+
+    // One deque per worker, plus a shared one for outside threads
+    for (int q = 0; q < threads; q++) this->queues.push_back(new Queue());
+    for (int w = 0; w < threads - 1; w++) {
+        this->workers.push_back(std::thread(&WorkStealingPool::Work, this, w, on_start));
+    }
+}
+
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->sleep_mutex);
+        this->stop = true;
+    }
+    this->wake.notify_all();
+    for (size_t w = 0; w < this->workers.size(); w++) this->workers[w].join();
+    for (size_t q = 0; q < this->queues.size(); q++) delete this->queues[q];
+}
+
+
+// Runs parts tasks (see Executor). The first part is run by the calling
+// thread, which then runs queued parts (its own first) until all of its
+// parts are done, or sleeps once there is nothing left to run while its
+// last parts complete on other threads.
+void WorkStealingPool::Run(int parts, const std::function<void(int)> &task)
+{
+    if (parts <= 0) return;
+
+    Group group;
+    group.task = &task;
+    group.pending = parts;
+
+    const int own = (worker_pool == this) ? worker_number : (int)this->queues.size() - 1;
+    if (parts > 1) {
+        {
+            std::lock_guard<std::mutex> lock(this->queues[own]->mutex);
+            for (int p = parts - 1; p > 0; p--) {
+                Task queued_task = { &group, p };
+                this->queues[own]->tasks.push_back(queued_task);
+            }
+        }
+        this->queued += parts - 1;
+        {
+            std::lock_guard<std::mutex> lock(this->sleep_mutex);
+        }
+        this->wake.notify_all();
+    }
+
+    Task first = { &group, 0 };
+    this->Execute(first);
+
+    while (group.pending.load(std::memory_order_acquire) > 0) {
+        if (this->RunOne(own)) continue;
+
+        std::unique_lock<std::mutex> lock(group.mutex);
+        group.done.wait(lock, [&group] { return group.pending.load(std::memory_order_acquire) == 0; });
+    }
+
+    // The last part signals under the group mutex: taking it once more
+    // ensures no thread touches the group after it goes out of scope
+    std::lock_guard<std::mutex> lock(group.mutex);
+    if (group.error) std::rethrow_exception(group.error);
+}
+
+
+// Returns the number of threads of the pool (workers and caller)
+int WorkStealingPool::GetConcurrency() const
+{
+    return (int)this->workers.size() + 1;
+}
+
+
+/* **************************** PRIVATE METHODS ***************************** */
+
+
+// Worker loop: runs queued parts, sleeping while there are none
+void WorkStealingPool::Work(int worker, const std::function<void(int)> &on_start)
+{
+    worker_pool = this;
+    worker_number = worker;
+    if (on_start) on_start(worker);
+
+    while (true) {
+        if (this->RunOne(worker)) continue;
+
+        std::unique_lock<std::mutex> lock(this->sleep_mutex);
+        this->wake.wait(lock, [this] { return this->stop || this->queued.load() > 0; });
+        if (this->stop) return;
+    }
+}
+
+
+// Runs one queued part: the newest of the given deque, or else the oldest
+// of another one. Returns false if there was none.
+bool WorkStealingPool::RunOne(int queue)
+{
+    const int queues = (int)this->queues.size();
+    Task task;
+    bool found = false;
+
+    {
+        Queue &own = *this->queues[queue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (int i = 1; i < queues && !found; i++) {
+        Queue &other = *this->queues[(queue + i) % queues];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = other.tasks.front();
+            other.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+
+    this->queued--;
+    this->Execute(task);
+    return true;
+}
+
+
+// Runs a part, recording its exception if any
+void WorkStealingPool::Execute(const Task &task)
+{
+    Group *group = task.group;
+    try {
+        (*group->task)(task.part);
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        if (!group->error) group->error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(group->mutex);
+    if (group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) group->done.notify_all();
+}
+
+} //namespace sbf
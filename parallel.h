@@ -0,0 +1,152 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// OS specific headers
+#if defined(__MINGW32__) || defined(__MINGW64__)
+#include "win/libexport.h"
+#elif defined(_MSC_VER)
+#include "win/libexport.h"
+#elif __GNUC__
+#include "linux/libexport.h"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace sbf {
+
+	// Scheduler of the parallel operations of the library. Run executes
+	// task(part) for every part in [0, parts) and returns once all of them
+	// have completed (rethrowing the first exception thrown by a part); it
+	// may be called from within a running part. Parts must not wait for each
+	// other, as they may run one after the other. GetConcurrency is the
+	// number of parts worth running at once, which bounds the number of
+	// threads used by every operation (see ThreadCount).
+	class DLL_PUBLIC Executor
+	{
+
+	public:
+		virtual ~Executor() {}
+
+		virtual void Run(int parts, const std::function<void(int)> &task) = 0;
+		virtual int GetConcurrency() const = 0;
+	};
+
+
+	// The default executor: a fixed pool of worker threads, each with its own
+	// deque of parts. Run queues the parts on the deque of the calling worker
+	// (or on a shared one for outside threads) and helps running queued parts
+	// until its own are done; idle workers steal from the other deques. The
+	// calling thread counts towards the concurrency, so a pool of n threads
+	// starts n - 1 workers. on_start, if given, is called by each worker
+	// when it starts (e.g. to set its affinity).
+	class DLL_PUBLIC WorkStealingPool : public Executor
+	{
+
+	public:
+		WorkStealingPool(int threads, const std::function<void(int)> &on_start = std::function<void(int)>());
+		~WorkStealingPool();
+
+		// Public methods (commented in the parallel.cpp)
+		void Run(int parts, const std::function<void(int)> &task);
+		int GetConcurrency() const;
+
+	private:
+		struct Group;
+		struct Task
+		{
+			Group *group;
+			int part;
+		};
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<Queue*> queues;
+		std::vector<std::thread> workers;
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+		std::atomic<int> queued;
+		bool stop;
+
+		// Private methods (commented in the parallel.cpp)
+		void Work(int worker, const std::function<void(int)> &on_start);
+		bool RunOne(int queue);
+		void Execute(const Task &task);
+
+		WorkStealingPool(const WorkStealingPool&);
+		WorkStealingPool& operator=(const WorkStealingPool&);
+	};
+
+
+	// Sets the executor used by all the parallel operations (not owned; it
+	// must outlive them). NULL restores the default pool, which has one
+	// thread per hardware thread.
+	DLL_PUBLIC void SetExecutor(Executor *executor);
+	DLL_PUBLIC Executor &GetExecutor();
+
+
+	// Returns the number of threads to be used for a requested value:
+	// 0 (or less) stands for the concurrency of the executor, and larger
+	// requests are capped to it
+	inline int ThreadCount(int threads)
+	{
+		int concurrency = GetExecutor().GetConcurrency();
+		if (concurrency <= 0) concurrency = 1;
+		return (threads <= 0 || threads > concurrency) ? concurrency : threads;
+	}
+
+
+	// Splits [0, count) into 'threads' contiguous ranges and runs
+	// fn(thread, begin, end) on each of them through the executor. A single
+	// range is run directly by the calling thread.
+	template <typename F>
+	void ParallelFor(int threads, long long count, F fn)
+	{
+		threads = ThreadCount(threads);
+		if (count < threads) threads = (count > 0) ? (int)count : 1;
+
+		if (threads == 1) {
+			fn(0, 0LL, count);
+			return;
+		}
+		GetExecutor().Run(threads, [&](int t) {
+			fn(t, count * t / threads, count * (t + 1) / threads);
+		});
+	}
+
+} //namespace sbf
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,489 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define SBF_DLL
+
+#include "planner.h"
+
+#include <algorithm>
+#include <climits>
+#include <math.h>
+#include <stdexcept>
+#include <utility>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// Probability that a cell is still empty after n insertions of k digests
+// each into 2^bit_mapping cells, (1 - 1/cells)^(k*n)
+double Empty(const int bit_mapping, const int HASH_number, const long long members)
+{
+    double cells = ldexp(1.0, bit_mapping);
+    return exp((double)HASH_number * (double)members * log1p(-1 / cells));
+}
+
+
+// Probability that k digests all hit a non-empty cell, (1 - empty)^k
+double AllFilled(const double empty, const int HASH_number)
+{
+    return pow(1 - empty, HASH_number);
+}
+
+
+// Returns the largest bit_mapping within the memory cap of the targets (and
+// within the int size of the cells array)
+int MaxBitMapping(const PlannerTargets &targets, const int AREA_number)
+{
+    int max_bit_mapping = 0;
+    for (int b = 1; b <= SBF::MAX_BIT_MAPPING; b++) {
+        long long bytes = Planner::Bytes(b, AREA_number);
+        if (bytes > INT_MAX) break;
+        if (targets.max_bytes > 0 && bytes > targets.max_bytes) break;
+        max_bit_mapping = b;
+    }
+    if (max_bit_mapping == 0) throw std::invalid_argument("The memory cap is too small for any filter.");
+    return max_bit_mapping;
+}
+
+
+// Validates the probability and hash targets
+void CheckTargets(const PlannerTargets &targets)
+{
+    if (targets.max_fpp >= 1 || targets.max_isep >= 1 || targets.min_safeness >= 1) throw std::invalid_argument("Invalid probability target.");
+    if (targets.max_hash_number <= 0 || targets.max_hash_number > SBF::MAX_HASH_NUMBER) throw std::invalid_argument("Invalid number of hash runs.");
+}
+
+
+// Returns the number of elements of each area of a filter
+std::vector<long long> FilterMembers(const SBF &filter)
+{
+    std::vector<long long> AREA_members(filter.GetAreaNumber() + 1, 0);
+    for (int a = 1; a <= filter.GetAreaNumber(); a++) AREA_members[a] = filter.GetAreaMembers(a);
+    return AREA_members;
+}
+
+} //namespace
+
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+PlannerTargets::PlannerTargets()
+{
+    this->max_fpp = 0.001;
+    this->max_isep = 0;
+    this->min_safeness = 0;
+    this->max_bytes = 0;
+    this->max_hash_number = 32;
+}
+
+
+FilterPlan::FilterPlan()
+{
+    this->feasible = false;
+    this->bit_mapping = 0;
+    this->HASH_number = 0;
+    this->AREA_number = 0;
+    this->cell_size = 0;
+    this->bytes = 0;
+    this->fpp = -1;
+    this->max_isep = -1;
+    this->safeness = -1;
+}
+
+
+// AREA_members[a] is the number of elements of area a (index 0 is unused)
+Planner::Planner(const std::vector<long long> &AREA_members)
+{
+    int AREA_number = (int)AREA_members.size() - 1;
+    if (AREA_number <= 0 || AREA_number > SBF::MAX_AREA_NUMBER) throw std::invalid_argument("Invalid number of areas.");
+
+    this->AREA_members = AREA_members;
+    this->AREA_members[0] = 0;
+
+    // suffix[a] is the number of elements of the areas from a upwards
+    this->suffix.assign(AREA_number + 2, 0);
+    for (int a = AREA_number; a > 0; a--) {
+        if (AREA_members[a] < 0) throw std::invalid_argument("Invalid number of members.");
+        this->suffix[a] = this->suffix[a + 1] + AREA_members[a];
+    }
+    if (this->suffix[1] == 0) throw std::invalid_argument("No members to plan for.");
+}
+
+
+// Plans for the area sizes of an existing filter (e.g. to resize it)
+Planner::Planner(const SBF &filter) : Planner(FilterMembers(filter))
+{
+}
+
+
+// Returns the cheapest configuration meeting the targets. If none fits in
+// the memory cap, returns the one with the lowest fpp among the largest
+// configurations allowed, flagged as not feasible.
+FilterPlan Planner::Plan(const PlannerTargets &targets) const
+{
+    CheckTargets(targets);
+    const int max_bit_mapping = MaxBitMapping(targets, this->GetAreaNumber());
+
+    int best_bit_mapping = 0, best_hash_number = 0;
+    for (int k = 1; k <= targets.max_hash_number; k++) {
+        if (!this->Meets(targets, max_bit_mapping, k)) continue;
+
+        int low = 1, high = max_bit_mapping;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (this->Meets(targets, mid, k)) high = mid;
+            else low = mid + 1;
+        }
+        if (best_bit_mapping == 0 || low < best_bit_mapping) {
+            best_bit_mapping = low;
+            best_hash_number = k;
+        }
+    }
+
+    if (best_bit_mapping > 0) {
+        FilterPlan plan = this->Evaluate(best_bit_mapping, best_hash_number);
+        plan.feasible = true;
+        return plan;
+    }
+
+    // Best effort: the lowest fpp with the largest filter allowed
+    int k = 1;
+    for (int j = 2; j <= targets.max_hash_number; j++) {
+        if (this->Fpp(max_bit_mapping, j) < this->Fpp(max_bit_mapping, k)) k = j;
+    }
+    return this->Evaluate(max_bit_mapping, k);
+}
+
+
+// Computes the a-priori properties of the given configuration, as
+// SetAPrioriAreaFpp, SetAPrioriAreaIsep and SetExpectedAreaCells would for a
+// filter holding these areas (the feasible flag is left unset)
+FilterPlan Planner::Evaluate(const int bit_mapping, const int HASH_number) const
+{
+    if (bit_mapping <= 0 || bit_mapping > SBF::MAX_BIT_MAPPING) throw std::invalid_argument("Invalid bit mapping.");
+    if (HASH_number <= 0 || HASH_number > SBF::MAX_HASH_NUMBER) throw std::invalid_argument("Invalid number of hash runs.");
+
+    const int AREA_number = this->GetAreaNumber();
+    const double cells = ldexp(1.0, bit_mapping);
+
+    FilterPlan plan;
+    plan.bit_mapping = bit_mapping;
+    plan.HASH_number = HASH_number;
+    plan.AREA_number = AREA_number;
+    plan.cell_size = Planner::CellSize(AREA_number);
+    plan.bytes = Planner::Bytes(bit_mapping, AREA_number);
+    plan.fpp = this->Fpp(bit_mapping, HASH_number);
+    plan.AREA_a_priori_fpp.assign(AREA_number + 1, -1);
+    plan.AREA_a_priori_isep.assign(AREA_number + 1, -1);
+    plan.AREA_a_priori_safep.assign(AREA_number + 1, -1);
+    plan.AREA_expected_cells.assign(AREA_number + 1, -1);
+
+    // The fpp of the areas from a upwards sum up to the probability that all
+    // the digests hit cells of these areas
+    double log_safeness = 0;
+    plan.max_isep = 0;
+    for (int a = AREA_number; a > 0; a--) {
+        double empty_above = Empty(bit_mapping, HASH_number, this->suffix[a + 1]);
+        double isep = AllFilled(empty_above, HASH_number);
+        double log_safep = (double)this->AREA_members[a] * log1p(-isep);
+
+        plan.AREA_a_priori_fpp[a] = AllFilled(Empty(bit_mapping, HASH_number, this->suffix[a]), HASH_number) - AllFilled(empty_above, HASH_number);
+        if (plan.AREA_a_priori_fpp[a] < 0) plan.AREA_a_priori_fpp[a] = 0;
+        plan.AREA_a_priori_isep[a] = isep;
+        plan.AREA_a_priori_safep[a] = exp(log_safep);
+        plan.AREA_expected_cells[a] = cells * empty_above * (1 - Empty(bit_mapping, HASH_number, this->AREA_members[a]));
+
+        if (isep > plan.max_isep) plan.max_isep = isep;
+        log_safeness += log_safep;
+    }
+    plan.safeness = exp(log_safeness);
+
+    return plan;
+}
+
+
+// Returns the number of areas planned for
+int Planner::GetAreaNumber() const
+{
+    return (int)this->AREA_members.size() - 1;
+}
+
+
+// Returns the total number of elements planned for
+long long Planner::GetMembers() const
+{
+    return this->suffix[1];
+}
+
+
+// Returns the size in bytes of a cell for the given number of areas (see the
+// SBF constructor)
+int Planner::CellSize(const int AREA_number)
+{
+    return (AREA_number <= 255) ? 1 : 2;
+}
+
+
+// Returns the size in bytes of the cells array of a filter
+long long Planner::Bytes(const int bit_mapping, const int AREA_number)
+{
+    return (long long)Planner::CellSize(AREA_number) << bit_mapping;
+}
+
+
+/* **************************** PRIVATE METHODS ***************************** */
+
+
+// Whether the given configuration meets the targets (the memory cap aside)
+bool Planner::Meets(const PlannerTargets &targets, const int bit_mapping, const int HASH_number) const
+{
+    if (targets.max_fpp > 0 && this->Fpp(bit_mapping, HASH_number) > targets.max_fpp) return false;
+
+    // The first area has all the others above it, so its isep is the highest
+    if (targets.max_isep > 0 && this->GetAreaNumber() > 1) {
+        if (AllFilled(Empty(bit_mapping, HASH_number, this->suffix[2]), HASH_number) > targets.max_isep) return false;
+    }
+
+    if (targets.min_safeness > 0 && this->LogSafeness(bit_mapping, HASH_number) < log(targets.min_safeness)) return false;
+
+    return true;
+}
+
+
+// Returns the a-priori false positives probability of the whole filter (see
+// SBF::GetFilterAPrioriFpp)
+double Planner::Fpp(const int bit_mapping, const int HASH_number) const
+{
+    return AllFilled(Empty(bit_mapping, HASH_number, this->suffix[1]), HASH_number);
+}
+
+
+// Returns the logarithm of the a-priori safeness probability
+double Planner::LogSafeness(const int bit_mapping, const int HASH_number) const
+{
+    double log_safeness = 0;
+    for (int a = this->GetAreaNumber() - 1; a > 0; a--) {
+        double isep = AllFilled(Empty(bit_mapping, HASH_number, this->suffix[a + 1]), HASH_number);
+        log_safeness += (double)this->AREA_members[a] * log1p(-isep);
+    }
+    return log_safeness;
+}
+
+
+/* ************************ LABEL OPTIMIZER METHODS ************************ */
+
+
+// sizes[s] is the number of elements of the s-th set, max_isep[s] its
+// a-priori isep goal (when not positive, PlannerTargets::max_isep applies)
+// and priorities[s] its priority (higher values get higher labels on ties).
+// max_isep and priorities may be empty.
+LabelOptimizer::LabelOptimizer(const std::vector<long long> &sizes, const std::vector<double> &max_isep, const std::vector<int> &priorities)
+{
+    if (sizes.empty() || sizes.size() > (size_t)SBF::MAX_AREA_NUMBER) throw std::invalid_argument("Invalid number of areas.");
+    if (!max_isep.empty() && max_isep.size() != sizes.size()) throw std::invalid_argument("One isep goal per set is required.");
+    if (!priorities.empty() && priorities.size() != sizes.size()) throw std::invalid_argument("One priority per set is required.");
+
+    long long total = 0;
+    for (size_t s = 0; s < sizes.size(); s++) {
+        if (sizes[s] < 0) throw std::invalid_argument("Invalid number of members.");
+        if (!max_isep.empty() && max_isep[s] >= 1) throw std::invalid_argument("Invalid probability target.");
+        total += sizes[s];
+    }
+    if (total == 0) throw std::invalid_argument("No members to plan for.");
+
+    this->sizes = sizes;
+    this->goals = max_isep.empty() ? std::vector<double>(sizes.size(), 0) : max_isep;
+    this->priorities = priorities.empty() ? std::vector<int>(sizes.size(), 0) : priorities;
+}
+
+
+// Returns the labels and the cheapest configuration (fewest bytes, then
+// fewest digests) meeting the per-set isep goals and the fpp target
+// (min_safeness is not considered). If none fits in the memory cap, the sets
+// are labelled by priority in the largest configuration allowed, flagged as
+// not feasible.
+LabelAssignment LabelOptimizer::Optimize(const PlannerTargets &targets) const
+{
+    CheckTargets(targets);
+
+    const int sets = (int)this->sizes.size();
+    const int max_bit_mapping = MaxBitMapping(targets, sets);
+
+    // Sets sharing a goal keep the same relative order in every
+    // configuration (by size, then priority), so they are sorted once into
+    // groups, and each configuration only merges the groups
+    std::vector<std::pair<double, int> > by_goal(sets);
+    for (int s = 0; s < sets; s++) {
+        double goal = (this->goals[s] > 0) ? this->goals[s] : targets.max_isep;
+        by_goal[s] = std::make_pair((goal > 0) ? goal : 1, s);
+    }
+    std::sort(by_goal.begin(), by_goal.end(), [this](const std::pair<double, int> &a, const std::pair<double, int> &b) {
+        if (a.first != b.first) return a.first < b.first;
+        return this->Before(a.second, b.second, 0);
+    });
+
+    std::vector<double> goals;
+    std::vector<std::vector<int> > groups;
+    for (int i = 0; i < sets; i++) {
+        if (goals.empty() || by_goal[i].first != goals.back()) {
+            goals.push_back(by_goal[i].first);
+            groups.push_back(std::vector<int>());
+        }
+        groups.back().push_back(by_goal[i].second);
+    }
+
+    std::vector<double> slack(groups.size());
+    std::vector<int> order;
+
+    int best_bit_mapping = 0, best_hash_number = 0;
+    for (int k = 1; k <= targets.max_hash_number; k++) {
+        // A set meets its goal g with up to slack / -(k ln(1 - 1/cells))
+        // elements above it, as isep = (1 - (1 - 1/cells)^(k above))^k
+        for (size_t g = 0; g < groups.size(); g++) {
+            slack[g] = (goals[g] < 1) ? -log1p(-pow(goals[g], 1.0 / k)) : HUGE_VAL;
+        }
+
+        // Only sizes below the best one so far are worth testing
+        int high = (best_bit_mapping > 0) ? best_bit_mapping - 1 : max_bit_mapping;
+        if (high < 1 || !this->Order(targets, high, k, groups, slack, order)) continue;
+
+        int low = 1;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (this->Order(targets, mid, k, groups, slack, order)) high = mid;
+            else low = mid + 1;
+        }
+        best_bit_mapping = low;
+        best_hash_number = k;
+    }
+
+    if (best_bit_mapping > 0) {
+        for (size_t g = 0; g < groups.size(); g++) {
+            slack[g] = (goals[g] < 1) ? -log1p(-pow(goals[g], 1.0 / best_hash_number)) : HUGE_VAL;
+        }
+        this->Order(targets, best_bit_mapping, best_hash_number, groups, slack, order);
+
+        LabelAssignment assignment = this->Assign(order, best_bit_mapping, best_hash_number);
+        assignment.feasible = true;
+        assignment.plan.feasible = true;
+        return assignment;
+    }
+
+    // Best effort: the lowest fpp with the largest filter allowed, the
+    // highest priorities on top
+    std::vector<long long> AREA_members(2, 0);
+    for (int s = 0; s < sets; s++) AREA_members[1] += this->sizes[s];
+    Planner planner(AREA_members);
+    int k = 1;
+    for (int j = 2; j <= targets.max_hash_number; j++) {
+        if (planner.Evaluate(max_bit_mapping, j).fpp < planner.Evaluate(max_bit_mapping, k).fpp) k = j;
+    }
+
+    order.resize(sets);
+    for (int s = 0; s < sets; s++) order[s] = s;
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return this->priorities[a] > this->priorities[b]; });
+    return this->Assign(order, max_bit_mapping, k);
+}
+
+
+/* **************************** PRIVATE METHODS ***************************** */
+
+
+// Whether set a goes above set b given the difference between their
+// deadlines (see Order): earlier deadline, then smaller size, higher
+// priority, lower index
+bool LabelOptimizer::Before(const int a, const int b, const double difference) const
+{
+    if (difference != 0) return difference < 0;
+    if (this->sizes[a] != this->sizes[b]) return this->sizes[a] < this->sizes[b];
+    if (this->priorities[a] != this->priorities[b]) return this->priorities[a] > this->priorities[b];
+    return a < b;
+}
+
+
+// Orders the sets from the top label down (earliest deadline first) and
+// returns whether every set meets its goal in the given configuration, as
+// well as the fpp target. groups and slack are as computed by Optimize for
+// HASH_number.
+bool LabelOptimizer::Order(const PlannerTargets &targets, const int bit_mapping, const int HASH_number, const std::vector<std::vector<int> > &groups, const std::vector<double> &slack, std::vector<int> &order) const
+{
+    const int sets = (int)this->sizes.size();
+
+    long long total = 0;
+    for (int s = 0; s < sets; s++) total += this->sizes[s];
+    if (targets.max_fpp > 0 && AllFilled(Empty(bit_mapping, HASH_number, total), HASH_number) > targets.max_fpp) return false;
+
+    // Maximum number of elements above each set (its slack, scaled), and the
+    // deadline by which the set itself must be placed; the groups are
+    // merged by deadline
+    const double scale = 1 / (-(double)HASH_number * log1p(-1 / ldexp(1.0, bit_mapping)));
+    std::vector<size_t> next(groups.size(), 0);
+    auto deadline = [&](size_t g) { return slack[g] * scale + (double)this->sizes[groups[g][next[g]]]; };
+    auto later = [&](size_t a, size_t b) {
+        return this->Before(groups[b][next[b]], groups[a][next[a]], deadline(b) - deadline(a));
+    };
+    std::vector<size_t> heap;
+    for (size_t g = 0; g < groups.size(); g++) heap.push_back(g);
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    order.resize(sets);
+    long long above = 0;
+    for (int i = 0; i < sets; i++) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        size_t g = heap.back();
+        int s = groups[g][next[g]];
+        if ((double)above > slack[g] * scale) return false;
+        order[i] = s;
+        above += this->sizes[s];
+
+        if (++next[g] < groups[g].size()) std::push_heap(heap.begin(), heap.end(), later);
+        else heap.pop_back();
+    }
+    return true;
+}
+
+
+// Labels the sets given in order from the top label down, and evaluates the
+// resulting filter
+LabelAssignment LabelOptimizer::Assign(const std::vector<int> &order, const int bit_mapping, const int HASH_number) const
+{
+    const int sets = (int)this->sizes.size();
+
+    LabelAssignment assignment;
+    assignment.feasible = false;
+    assignment.labels.resize(sets);
+
+    std::vector<long long> AREA_members(sets + 1, 0);
+    for (int i = 0; i < sets; i++) {
+        assignment.labels[order[i]] = sets - i;
+        AREA_members[sets - i] = this->sizes[order[i]];
+    }
+    assignment.plan = Planner(AREA_members).Evaluate(bit_mapping, HASH_number);
+    return assignment;
+}
+
+} //namespace sbf
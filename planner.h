@@ -0,0 +1,162 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "sbf.h"
+
+#include <vector>
+
+
+namespace sbf {
+
+	// Targets of the parameter planner. Probability targets are ignored when
+	// not positive, and the memory cap when 0.
+	struct DLL_PUBLIC PlannerTargets
+	{
+		// Maximum a-priori false positives probability of the whole filter
+		// (see SBF::GetFilterAPrioriFpp)
+		double max_fpp;
+		// Maximum a-priori inter-set error probability of every area (see
+		// SBF::SetAPrioriAreaIsep)
+		double max_isep;
+		// Minimum a-priori safeness probability of the whole filter (see
+		// SBF::SetAPrioriAreaIsep)
+		double min_safeness;
+		// Maximum size in bytes of the cells array
+		long long max_bytes;
+		// Largest number of digests per element to consider
+		int max_hash_number;
+
+		PlannerTargets();
+	};
+
+
+	// A filter configuration and its a-priori properties
+	struct DLL_PUBLIC FilterPlan
+	{
+		// Whether the configuration meets all the targets (otherwise it is
+		// the configuration with the lowest fpp within the memory cap)
+		bool feasible;
+		int bit_mapping;
+		int HASH_number;
+		int AREA_number;
+		int cell_size;
+		long long bytes;
+		double fpp;
+		double max_isep;
+		double safeness;
+		// Per-area a-priori values, indexed by area label (index 0 unused)
+		std::vector<double> AREA_a_priori_fpp;
+		std::vector<double> AREA_a_priori_isep;
+		std::vector<double> AREA_a_priori_safep;
+		std::vector<double> AREA_expected_cells;
+
+		FilterPlan();
+	};
+
+
+	// Sizes a filter from the number of elements of each area and a set of
+	// targets, instead of a hand-picked bit_mapping and HASH_number. The
+	// candidate configurations are scored with the a-priori formulas of the
+	// SBF class, in closed form over the per-area suffix sums of members.
+	// Since every probability improves with the number of cells, the
+	// smallest bit_mapping meeting the targets is found by bisection for each
+	// HASH_number, and the cheapest configuration (fewest bytes, then fewest
+	// digests) is returned. Filters only have 2^bit_mapping cells, so sizes
+	// in between are not considered.
+	class DLL_PUBLIC Planner
+	{
+
+	private:
+		std::vector<long long> AREA_members;
+		std::vector<long long> suffix;
+
+		// Private methods (commented in the planner.cpp)
+		bool Meets(const PlannerTargets &targets, const int bit_mapping, const int HASH_number) const;
+		double Fpp(const int bit_mapping, const int HASH_number) const;
+		double LogSafeness(const int bit_mapping, const int HASH_number) const;
+
+
+	public:
+		Planner(const std::vector<long long> &AREA_members);
+		Planner(const SBF &filter);
+
+		// Public methods (commented in the planner.cpp)
+		FilterPlan Plan(const PlannerTargets &targets) const;
+		FilterPlan Evaluate(const int bit_mapping, const int HASH_number) const;
+		int GetAreaNumber() const;
+		long long GetMembers() const;
+		static int CellSize(const int AREA_number);
+		static long long Bytes(const int bit_mapping, const int AREA_number);
+	};
+
+
+	// Area labels chosen for a list of application sets (see LabelOptimizer)
+	struct DLL_PUBLIC LabelAssignment
+	{
+		// Whether the configuration meets all the targets
+		bool feasible;
+		// labels[s] is the area label of the s-th set
+		std::vector<int> labels;
+		// The filter configuration and its a-priori properties, with the
+		// sets so labelled
+		FilterPlan plan;
+	};
+
+
+	// Chooses the area label of each application set, together with the
+	// filter size, so that every set meets its inter-set error goal with the
+	// fewest cells. Since higher labels overwrite lower ones, the a-priori
+	// isep of a set only depends on the number of elements above it, and a
+	// goal translates into a maximum number of elements above the set (a
+	// closed form of bit_mapping and HASH_number). Labelling the sets from
+	// the top down in order of that maximum plus their own size (earliest
+	// deadline first) meets all the goals whenever any labelling does, so
+	// each configuration is tested by merging the sets, grouped by goal and
+	// sorted once. Ties go to the smaller set, then to the higher priority.
+	class DLL_PUBLIC LabelOptimizer
+	{
+
+	private:
+		std::vector<long long> sizes;
+		std::vector<double> goals;
+		std::vector<int> priorities;
+
+		// Private methods (commented in the planner.cpp)
+		bool Before(const int a, const int b, const double difference) const;
+		bool Order(const PlannerTargets &targets, const int bit_mapping, const int HASH_number, const std::vector<std::vector<int> > &groups, const std::vector<double> &slack, std::vector<int> &order) const;
+		LabelAssignment Assign(const std::vector<int> &order, const int bit_mapping, const int HASH_number) const;
+
+	public:
+		LabelOptimizer(const std::vector<long long> &sizes, const std::vector<double> &max_isep, const std::vector<int> &priorities);
+
+		// Public methods (commented in the planner.cpp)
+		LabelAssignment Optimize(const PlannerTargets &targets) const;
+	};
+
+} //namespace sbf
+
+#endif /* PLANNER_H */
@@ -0,0 +1,75 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef PROBES_H
+#define PROBES_H
+
+// Static tracepoints (USDT, as used by SystemTap, perf and bpftrace) in the
+// hot paths of the library. They are only compiled in when SBF_USDT is
+// defined, and require the <sys/sdt.h> header (systemtap-sdt-dev). When no
+// tracer is attached, each probe is a single nop instruction.
+//
+// Probes of the "libsbf" provider and their arguments:
+// insert__entry        element length, area
+// insert__return       element length, area, collisions caused by the insert
+// check__entry         element length
+// check__return        element length, returned area, number of digests computed
+// cell__collision      cell index, area being inserted, area already stored
+// stats__entry         name of the statistics method (string)
+// stats__return        name of the statistics method (string)
+// salt__load__entry    salt file path (string), number of salts
+// salt__load__return   salt file path (string), number of salts
+// salt__create__entry  salt file path (string), number of salts
+// salt__create__return salt file path (string), number of salts
+// save__entry          output file path (string), mode
+// save__return         output file path (string), mode
+//
+// For instance, to trace slow checks with bpftrace:
+// bpftrace -e 'usdt:./libsbf.so:libsbf:check__entry { @s[tid] = nsecs; }
+//   usdt:./libsbf.so:libsbf:check__return /@s[tid]/ {
+//   @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+
+#if defined(SBF_USDT)
+
+#include <sys/sdt.h>
+
+// The probes only work with the systemtap header, which defines STAP_PROBE3
+// and emits the .note.stapsdt ELF notes read by the tracers (readelf -n
+// lists them); other headers providing DTRACE_PROBE macros are rejected
+#ifndef STAP_PROBE3
+#error "SBF_USDT requires <sys/sdt.h> from systemtap-sdt-dev"
+#endif
+
+#define SBF_PROBE1(name, a) DTRACE_PROBE1(libsbf, name, a)
+#define SBF_PROBE2(name, a, b) DTRACE_PROBE2(libsbf, name, a, b)
+#define SBF_PROBE3(name, a, b, c) DTRACE_PROBE3(libsbf, name, a, b, c)
+
+#else
+
+#define SBF_PROBE1(name, a) do {} while (0)
+#define SBF_PROBE2(name, a, b) do {} while (0)
+#define SBF_PROBE3(name, a, b, c) do {} while (0)
+
+#endif
+
+#endif /* PROBES_H */
@@ -0,0 +1,147 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define SBF_DLL
+
+#include "record.h"
+
+#include <stdexcept>
+
+
+namespace sbf {
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+InsertionRecorder::InsertionRecorder(int bit_mapping, int HASH_number)
+{
+    if (bit_mapping <= 0 || bit_mapping > 32) throw std::invalid_argument("Invalid bit mapping.");
+    if (HASH_number <= 0) throw std::invalid_argument("Invalid number of hash runs.");
+
+    this->bit_mapping = bit_mapping;
+    this->HASH_number = HASH_number;
+    this->bits = 0;
+    this->members = 0;
+}
+
+
+// Appends a cell index of the element being inserted (HASH_number calls per
+// element, followed by AddMember)
+void InsertionRecorder::AddIndex(unsigned int index)
+{
+    long long word = this->bits >> 6;
+    int offset = (int)(this->bits & 63);
+    uint64_t value = (uint64_t)index;
+
+    if ((size_t)word + 1 >= this->words.size()) this->words.resize(this->words.size() * 2 + 2, 0);
+
+    this->words[word] |= value << offset;
+    if (offset + this->bit_mapping > 64) this->words[word + 1] |= value >> (64 - offset);
+    this->bits += this->bit_mapping;
+}
+
+
+// Completes the element whose indices were just added, labelling it with
+// its area
+void InsertionRecorder::AddMember(int area)
+{
+    if (this->run_areas.empty() || this->run_areas.back() != area) {
+        this->run_areas.push_back(area);
+        this->run_starts.push_back(this->members);
+    }
+    this->members++;
+}
+
+
+// Copies the HASH_number cell indices of the member-th element (in order of
+// insertion) into indices. Concurrent calls are safe.
+void InsertionRecorder::GetIndices(long long member, unsigned int *indices) const
+{
+    const uint64_t mask = (1ULL << this->bit_mapping) - 1;
+    long long position = member * this->HASH_number * this->bit_mapping;
+
+    for (int k = 0; k < this->HASH_number; k++, position += this->bit_mapping) {
+        long long word = position >> 6;
+        int offset = (int)(position & 63);
+        uint64_t value = this->words[word] >> offset;
+        if (offset + this->bit_mapping > 64) value |= this->words[word + 1] << (64 - offset);
+        indices[k] = (unsigned int)(value & mask);
+    }
+}
+
+
+// Returns the number of recorded elements
+long long InsertionRecorder::GetMembers() const
+{
+    return this->members;
+}
+
+
+// Returns the number of cell indices recorded per element
+int InsertionRecorder::GetHashNumber() const
+{
+    return this->HASH_number;
+}
+
+
+// Returns the number of runs of consecutive elements of the same area (one
+// per area when the elements are inserted in ascending order of areas)
+int InsertionRecorder::GetRuns() const
+{
+    return (int)this->run_areas.size();
+}
+
+
+// Returns the area label of a run
+int InsertionRecorder::GetRunArea(int run) const
+{
+    return this->run_areas[run];
+}
+
+
+// Returns the index of the first element of a run (the run ends where the
+// next one starts, or at GetMembers)
+long long InsertionRecorder::GetRunStart(int run) const
+{
+    return this->run_starts[run];
+}
+
+
+// Returns the memory taken by the record, in bytes
+size_t InsertionRecorder::GetBytes() const
+{
+    return sizeof(InsertionRecorder) + this->words.capacity() * sizeof(uint64_t)
+        + this->run_areas.capacity() * sizeof(int) + this->run_starts.capacity() * sizeof(long long);
+}
+
+
+// Discards the recorded elements, releasing their memory
+void InsertionRecorder::Release()
+{
+    std::vector<uint64_t>().swap(this->words);
+    std::vector<int>().swap(this->run_areas);
+    std::vector<long long>().swap(this->run_starts);
+    this->bits = 0;
+    this->members = 0;
+}
+
+} //namespace sbf
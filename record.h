@@ -0,0 +1,81 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#ifndef RECORD_H
+#define RECORD_H
+
+// OS specific headers
+#if defined(__MINGW32__) || defined(__MINGW64__)
+#include "win/libexport.h"
+#elif defined(_MSC_VER)
+#include "win/libexport.h"
+#elif __GNUC__
+#include "linux/libexport.h"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+namespace sbf {
+
+	// Build-time record of the cells written by each inserted element,
+	// enabled through SBF::EnableRecorder. The HASH_number cell indices of
+	// each element are bit-packed at bit_mapping bits each (rather than the
+	// 32 bits of a digest), and the area labels are run-length encoded, so
+	// that the exact inter-set errors and emersion can later be computed from
+	// the final filter without hashing the elements again (see
+	// Evaluator::SelfCheck). The record can be released once analysed.
+	class DLL_PUBLIC InsertionRecorder
+	{
+
+	public:
+		InsertionRecorder(int bit_mapping, int HASH_number);
+
+		// Public methods (commented in the record.cpp)
+		void AddIndex(unsigned int index);
+		void AddMember(int area);
+		void GetIndices(long long member, unsigned int *indices) const;
+		long long GetMembers() const;
+		int GetHashNumber() const;
+		int GetRuns() const;
+		int GetRunArea(int run) const;
+		long long GetRunStart(int run) const;
+		size_t GetBytes() const;
+		void Release();
+
+	private:
+		int bit_mapping;
+		int HASH_number;
+		std::vector<uint64_t> words;
+		long long bits;
+		long long members;
+		std::vector<int> run_areas;
+		std::vector<long long> run_starts;
+	};
+
+} //namespace sbf
+
+#endif /* RECORD_H */
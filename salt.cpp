@@ -0,0 +1,255 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define SBF_DLL
+
+#include "salt.h"
+#include "base64.h"
+#include "end.h"
+#include "probes.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/md4.h>
+#include <openssl/md5.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+
+namespace sbf {
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+// Loads the salts from salt_path, or creates them there if the file does not
+// exist. The arguments are validated by the callers (see the SBF
+// constructor and FilterSet::AddFilter).
+HashSalt::HashSalt(int HASH_family, int HASH_number, const std::string &salt_path)
+{
+    // Checks whether the execution is being performed on a big endian or little endian machine
+    this->BIG_end = is_big_endian();
+
+    // Sets the type of hash function to be used and its digest length
+    this->HASH_family = HASH_family;
+    switch(this->HASH_family){
+        case 1:
+            this->digest_length = SHA_DIGEST_LENGTH;
+            break;
+        case 4:
+            this->digest_length = MD4_DIGEST_LENGTH;
+            break;
+        case 5:
+            this->digest_length = MD5_DIGEST_LENGTH;
+            break;
+        default:
+            this->digest_length = MD4_DIGEST_LENGTH;
+            break;
+    }
+
+    // Initializes the salt matrix
+    this->HASH_number = HASH_number;
+    this->salts = new BYTE*[HASH_number];
+    for (int j = 0; j < HASH_number; j++) {
+        this->salts[j] = new BYTE[HashSalt::MAX_INPUT_SIZE];
+    }
+
+    // Creates the hash salts or loads them from the specified file
+    std::ifstream my_file(salt_path.c_str());
+    if (my_file.good()) this->Load(salt_path);
+    else this->Create(salt_path);
+}
+
+
+HashSalt::~HashSalt()
+{
+    for (int j = 0; j < this->HASH_number; j++) {
+        delete[] this->salts[j];
+    }
+    delete[] this->salts;
+}
+
+
+// Computes the k-th digest of the input element, truncated to its first 32
+// bits. The element is combined via XOR with the k-th hash salt into buffer,
+// which must hold at least size bytes, while digest must hold at least
+// GetDigestLength() bytes.
+unsigned int HashSalt::Digest32(const char *string, int size, int k, char *buffer, unsigned char *digest) const
+{
+    for(int j=0; j<size; j++){
+        buffer[j] = (char)(string[j]^this->salts[k][j]);
+    }
+
+    this->Hash(buffer, size, digest);
+
+    // We allow a maximum SBF mapping of 32 bit (resulting in 2^32 cells).
+    // Thus, the hash digest is truncated to the first four bytes, which are
+    // copied (one byte at a time) in an integer variable (endian independent)
+    if (this->BIG_end) {
+        return ((unsigned int)digest[0] << 24) | (digest[1] << 16) | (digest[2] << 8) | digest[3];
+    }
+    else {
+        return ((unsigned int)digest[3] << 24) | (digest[2] << 16) | (digest[1] << 8) | digest[0];
+    }
+}
+
+
+// Computes the 'HASH_number' truncated 32-bit digests of the input element.
+// Throws std::invalid_argument if the element is longer than MAX_INPUT_SIZE.
+// char *string            the element to be hashed
+// int size                length of the element
+// unsigned int *digests   output array of (at least) HASH_number digests
+void HashSalt::Digest(const char *string, int size, unsigned int *digests) const
+{
+    if (size < 0 || size > HashSalt::MAX_INPUT_SIZE) throw std::invalid_argument("Invalid element size.");
+
+    char buffer[HashSalt::MAX_INPUT_SIZE];
+    unsigned char digest[HashSalt::MAX_DIGEST_LENGTH];
+
+    for(int k=0; k<this->HASH_number; k++){
+        digests[k] = this->Digest32(string, size, k, buffer, digest);
+    }
+}
+
+
+// Returns the hash function (see the constructor)
+int HashSalt::GetHashFamily() const
+{
+    return this->HASH_family;
+}
+
+
+// Returns the number of salts
+int HashSalt::GetHashNumber() const
+{
+    return this->HASH_number;
+}
+
+
+// Returns the length in bytes of the digests of the hash function
+int HashSalt::GetDigestLength() const
+{
+    return this->digest_length;
+}
+
+
+// Returns the bytes allocated for the salts (the salt matrix, its row
+// pointers and this object)
+size_t HashSalt::GetBytes() const
+{
+    return sizeof(HashSalt) + (size_t)this->HASH_number * (HashSalt::MAX_INPUT_SIZE + sizeof(BYTE*));
+}
+
+
+/* **************************** PRIVATE METHODS **************************** */
+
+
+// Computes the hash digest, calling the selected hash function
+// char *d            is the input of the hash value
+// size_t n           is the input length
+// unsigned char *md  is where the output should be written
+void HashSalt::Hash(char *d, size_t n, unsigned char *md) const
+{
+    switch(this->HASH_family){
+        case 1:
+            SHA1((unsigned char*)d, n, (unsigned char*)md);
+            break;
+        case 4:
+            MD4((unsigned char*)d, n, (unsigned char*)md);
+            break;
+        case 5:
+            MD5((unsigned char*)d, n, (unsigned char*)md);
+            break;
+        default:
+            MD4((unsigned char*)d, n, (unsigned char*)md);
+            break;
+    }
+}
+
+
+// Stores a hash salt byte array for each hash (the number of hashes is
+// HASH_number). Each input element will be combined with the salt via XOR, by
+// Digest32. The length of salts is MAX_INPUT_SIZE bytes.
+// Hashes are stored encoded in base64.
+// TODO: remove printf and manage with an exception the case of a failed salt
+void HashSalt::Create(const std::string &path)
+{
+    BYTE buffer[HashSalt::MAX_INPUT_SIZE];
+    int rc;
+    std::ofstream myfile;
+
+    SBF_PROBE2(salt__create__entry, path.c_str(), this->HASH_number);
+
+    myfile.open (path.c_str());
+
+    for(int i = 0; i < this->HASH_number; i++)
+    {
+        rc = RAND_bytes(buffer, sizeof(buffer));
+        if(rc != 1) {
+            //printf("Failed to generate hash salt.\n");
+            abort();
+        }
+
+        // Fills hash salt matrix
+        memcpy(this->salts[i], buffer, HashSalt::MAX_INPUT_SIZE);
+        // Writes hash salt to disk to the path given in input
+        std::string encoded = base64_encode(reinterpret_cast<const unsigned char*>(this->salts[i]), HashSalt::MAX_INPUT_SIZE);
+        myfile << encoded << std::endl;
+
+    }
+
+    myfile.close();
+
+    SBF_PROBE2(salt__create__return, path.c_str(), this->HASH_number);
+}
+
+
+// Loads from the path in input a hash salt byte array, one line per hash.
+// Hashes are stored encoded in base64, and need to be decoded.
+// TODO: manage exceptions for the getline, in particular when the number
+//       of lines does not match with
+void HashSalt::Load(const std::string &path)
+{
+    std::ifstream myfile;
+    std::string line;
+
+    SBF_PROBE2(salt__load__entry, path.c_str(), this->HASH_number);
+
+    myfile.open(path.c_str());
+
+    for(int i = 0; i < this->HASH_number; i++)
+    {
+        // Reads one base64 hash salt from file (one per line)
+        getline(myfile, line);
+
+        //decode and fill hash salt matrix
+        memcpy(this->salts[i], base64_decode(line).c_str(), HashSalt::MAX_INPUT_SIZE);
+    }
+
+    myfile.close();
+
+    SBF_PROBE2(salt__load__return, path.c_str(), this->HASH_number);
+}
+
+} //namespace sbf
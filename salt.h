@@ -0,0 +1,98 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#pragma once
+
+#ifndef SALT_H
+#define SALT_H
+
+// OS specific headers
+#if defined(__MINGW32__) || defined(__MINGW64__)
+#include <windef.h>
+#include "win/libexport.h"
+#elif defined(_MSC_VER)
+#include <windows.h>
+#include "win/libexport.h"
+#define WIN32_LEAN_AND_MEAN
+#elif __GNUC__
+#include "linux/lindef.h"
+#include "linux/libexport.h"
+#endif
+
+#include <stddef.h>
+#include <string>
+
+
+namespace sbf {
+
+	// The hash salts of a filter and the digest computation built on them:
+	// the k-th digest of an element is the hash of the element XORed with
+	// the k-th salt. The salts are read from a file (one base64 salt per
+	// line) or, if the file does not exist, randomly generated and written
+	// there. Used by the SBF class and shared by the filters of a FilterSet
+	// with the same hash configuration.
+	class DLL_PUBLIC HashSalt
+	{
+
+	private:
+		BYTE **salts;
+		int HASH_family;
+		int HASH_number;
+		int digest_length;
+		int BIG_end;
+
+		// Private methods (commented in the salt.cpp)
+		void Create(const std::string &path);
+		void Load(const std::string &path);
+		void Hash(char *d, size_t n, unsigned char *md) const;
+
+		HashSalt(const HashSalt&);
+		HashSalt& operator=(const HashSalt&);
+
+	public:
+		// The length in bytes of each salt, and so the maximum length of the
+		// elements
+		const static int MAX_INPUT_SIZE = 128;
+		// The length in bytes of the longest digest (SHA1)
+		const static int MAX_DIGEST_LENGTH = 20;
+
+		// HASH_family    the hash function (1: SHA1, 4: MD4, 5: MD5, any other
+		//                value: MD4)
+		// HASH_number    the number of salts (and digests per element)
+		// salt_path      the file where to read the salts from, or write them to
+		HashSalt(int HASH_family, int HASH_number, const std::string &salt_path);
+		~HashSalt();
+
+		// Public methods (commented in the salt.cpp)
+		unsigned int Digest32(const char *string, int size, int k, char *buffer, unsigned char *digest) const;
+		void Digest(const char *string, int size, unsigned int *digests) const;
+		int GetHashFamily() const;
+		int GetHashNumber() const;
+		int GetDigestLength() const;
+		size_t GetBytes() const;
+	};
+
+} //namespace sbf
+
+#endif /* SALT_H */
@@ -22,118 +22,133 @@
 #define SBF_DLL
 
 #include "sbf.h"
+#include "parallel.h"
+#include "probes.h"
 
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
-#include <openssl/md4.h>
-#include <openssl/md5.h>
-#include <openssl/rand.h>
-#include <openssl/sha.h>
+#ifdef SBF_INSTRUMENTATION
+#include <chrono>
+#endif
 
 
 namespace sbf{
 
-/* **************************** PRIVATE METHODS **************************** */
-
+// SplitMix64 finalizer, used to draw the sample of CountByArea
+static uint64_t Mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
 
-// Sets the hash digest length depending on the selected hash function
-void SBF::SetHashDigestLength()
+// Validates the sizes of a batch of elements, which must fit the hash salts
+// (and the MAX_INPUT_SIZE scratch buffers of the batch methods)
+static void CheckSizes(const int *sizes, long long count)
 {
-    switch(this->HASH_family){
-        case 1:
-            this->HASH_digest_length = SHA_DIGEST_LENGTH;
-            break;
-        case 4:
-            this->HASH_digest_length = MD4_DIGEST_LENGTH;
-            break;
-        case 5:
-            this->HASH_digest_length = MD5_DIGEST_LENGTH;
-            break;
-        default:
-            this->HASH_digest_length = MD4_DIGEST_LENGTH;
-            break;
+    for (long long i = 0; i < count; i++) {
+        if (sizes[i] < 0 || sizes[i] > SBF::MAX_INPUT_SIZE) throw std::invalid_argument("Invalid element size.");
     }
 }
 
-
-// Computes the hash digest, calling the selected hash function
-// char *d            is the input of the hash value
-// size_t n           is the input length
-// unsigned char *md  is where the output should be written
-void SBF::Hash(char *d, size_t n, unsigned char *md) const
+#ifdef SBF_INSTRUMENTATION
+// Returns the nanoseconds elapsed since start (instrumentation builds only)
+static uint64_t ElapsedNs(const std::chrono::steady_clock::time_point &start)
 {
-    switch(this->HASH_family){
-        case 1:
-            SHA1((unsigned char*)d, n, (unsigned char*)md);
-            break;
-        case 4:
-            MD4((unsigned char*)d, n, (unsigned char*)md);
-            break;
-        case 5:
-            MD5((unsigned char*)d, n, (unsigned char*)md);
-            break;
-        default:
-            MD4((unsigned char*)d, n, (unsigned char*)md);
-            break;
-    }
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
 }
+#endif
+
+/* **************************** PRIVATE METHODS **************************** */
 
 
-// Stores a hash salt byte array for each hash (the number of hashes is
-// HASH_number). Each input element will be combined with the salt via XOR, by
-// the Insert and Check methods. The length of salts is MAX_INPUT_SIZE bytes.
-// Hashes are stored encoded in base64.
-// TODO: remove printf and manage with an exception the case of a failed salt
-void SBF::CreateHashSalt(std::string path)
+// Verifies an element as Check does, but stops hashing at the first cell
+// holding a label lower than threshold (empty cells included): the result
+// is the area label if it is at least threshold, 0 otherwise. The Check
+// cache, if enabled, is used like Check does, storing only exact results.
+int SBF::CheckThreshold(const char *string, int size, int threshold, char *buffer, unsigned char *digest) const
 {
-    BYTE buffer[SBF::MAX_INPUT_SIZE];
-    int rc;
-    std::ofstream myfile;
+    uint64_t fingerprint = 0;
+    unsigned long long version = 0;
+    if (this->cache != NULL) {
+        int cached;
+        fingerprint = this->cache->Fingerprint(string, size);
+        version = this->version.load(std::memory_order_acquire);
+        if (this->cache->Lookup(fingerprint, version, &cached)) return (cached >= threshold) ? cached : 0;
+    }
 
-    myfile.open (path.c_str());
+    int area = 0;
+    int current_area = 0;
+    int k;
+
+    for(k=0; k<this->HASH_number; k++){
+        current_area = this->GetCell(this->salts->Digest32(string, size, k, buffer, digest) >> (SBF::MAX_BIT_MAPPING - this->bit_mapping));
 
-    for(int i = 0; i < this->HASH_number; i++)
-    {
-        rc = RAND_bytes(buffer, sizeof(buffer));
-        if(rc != 1) {
-            //printf("Failed to generate hash salt.\n");
-            abort();
+        // The result would be at most current_area, below the threshold
+        if(current_area < threshold){
+            area = 0;
+            break;
         }
+        else if(area == 0 || current_area < area) area = current_area;
+    }
 
-        // Fills hash salt matrix
-        memcpy(this->HASH_salt[i], buffer, SBF::MAX_INPUT_SIZE);
-        // Writes hash salt to disk to the path given in input
-        std::string encoded = base64_encode(reinterpret_cast<const unsigned char*>(this->HASH_salt[i]), SBF::MAX_INPUT_SIZE);
-        myfile << encoded << std::endl;
+    // The result is exact unless hashing stopped on a non-empty cell
+    if (this->cache != NULL && (k == this->HASH_number || current_area == 0)) this->cache->Store(fingerprint, version, area);
 
-    }
+#ifdef SBF_INSTRUMENTATION
+    if (this->instrumentation != NULL) this->instrumentation->RecordHashCalls((k < this->HASH_number) ? k + 1 : k);
+#endif
 
-    myfile.close();
+    return area;
 }
 
 
-// Loads from the path in input a hash salt byte array, one line per hash.
-// Hashes are stored encoded in base64, and need to be decoded.
-// TODO: manage exceptions for the getline, in particular when the number
-//       of lines does not match with
-void SBF::LoadHashSalt(std::string path)
+// Verifies a block of elements as CheckThreshold does, one hash round at a
+// time: each round computes the next digest of the elements still
+// undecided, which are then compacted at the front of undecided, so that
+// the elements rejected early drop out of the following rounds.
+// int *areas       output results (count entries)
+// int *undecided   scratch array of count entries
+void SBF::CheckBlock(const char *const *strings, const int *sizes, int count, int threshold, int *areas, int *undecided, char *buffer, unsigned char *digest) const
 {
-    std::ifstream myfile;
-    std::string line;
+    int remaining = count;
+    int hash_calls = 0;
 
-    myfile.open(path.c_str());
+    for (int i = 0; i < count; i++) {
+        areas[i] = 0;
+        undecided[i] = i;
+    }
 
-    for(int i = 0; i < this->HASH_number; i++)
-    {
-        // Reads one base64 hash salt from file (one per line)
-        getline(myfile, line);
+    for (int k = 0; k < this->HASH_number && remaining > 0; k++) {
+        int kept = 0;
 
-        //decode and fill hash salt matrix
-        memcpy(this->HASH_salt[i], base64_decode(line).c_str(), SBF::MAX_INPUT_SIZE);
+        for (int j = 0; j < remaining; j++) {
+            int i = undecided[j];
+            int current_area = this->GetCell(this->salts->Digest32(strings[i], sizes[i], k, buffer, digest) >> (SBF::MAX_BIT_MAPPING - this->bit_mapping));
+
+            if (current_area < threshold) {
+                areas[i] = 0;
+                continue;
+            }
+            if (areas[i] == 0 || current_area < areas[i]) areas[i] = current_area;
+            undecided[kept++] = i;
+        }
+
+        hash_calls += remaining;
+        remaining = kept;
     }
 
-    myfile.close();
+#ifdef SBF_INSTRUMENTATION
+    if (this->instrumentation != NULL) this->instrumentation->RecordHashCalls(hash_calls);
+#else
+    (void)hash_calls;
+#endif
 }
 
 
@@ -146,6 +161,10 @@ void SBF::SetCell(unsigned int index, int area)
 {
     int cell_value;
 
+#ifdef SBF_INSTRUMENTATION
+    if (this->heatmap != NULL) this->heatmap->RecordSet(index);
+#endif
+
     switch (this->cell_size){
         // 1-byte cell size
         case 1:
@@ -164,17 +183,20 @@ void SBF::SetCell(unsigned int index, int area)
                 // Sets cell value
                 this->filter[index] = (BYTE)area;
                 this->collisions++;
+                SBF_PROBE3(cell__collision, index, area, cell_value);
                 this->AREA_cells[area]++;
                 this->AREA_cells[cell_value]--;
             }
             else if(cell_value == area){
                 this->collisions++;
                 this->AREA_self_collisions[area]++;
+                SBF_PROBE3(cell__collision, index, area, cell_value);
             }
             // This condition should never be reached as long as elements are
             // processed in ascending order of area label
             else if(cell_value > area){
                 this->collisions++;
+                SBF_PROBE3(cell__collision, index, area, cell_value);
             }
             break;
         // 2-bytes cell size. Writing values over the two bytes is managed
@@ -199,12 +221,14 @@ void SBF::SetCell(unsigned int index, int area)
                 this->filter[2*index] = (BYTE)(area>>8);
                 this->filter[(2*index)+1] = (BYTE)area;
                 this->collisions++;
+                SBF_PROBE3(cell__collision, index, area, cell_value);
                 this->AREA_cells[area]++;
                 this->AREA_cells[cell_value]--;
             }
             else if(cell_value == area){
                 this->collisions++;
                 this->AREA_self_collisions[area]++;
+                SBF_PROBE3(cell__collision, index, area, cell_value);
             }
             // This condition should never be reached as long as elements are
             // processed in ascending order of area label. Self-collisions may
@@ -212,6 +236,7 @@ void SBF::SetCell(unsigned int index, int area)
             // following the ascending order of area labels.
             else if(cell_value > area){
                 this->collisions++;
+                SBF_PROBE3(cell__collision, index, area, cell_value);
             }
             break;
         default:
@@ -225,6 +250,10 @@ void SBF::SetCell(unsigned int index, int area)
 int SBF::GetCell(unsigned int index) const
 {
     int area;
+
+#ifdef SBF_INSTRUMENTATION
+    if (this->heatmap != NULL) this->heatmap->RecordGet(index);
+#endif
     switch (this->cell_size){
         // 1-byte cell size
         case 1:
@@ -317,6 +346,8 @@ void SBF::SaveToDisk(const std::string path, int mode)
 {
     std::ofstream myfile;
 
+    SBF_PROBE2(save__entry, path.c_str(), mode);
+
     myfile.open (path.c_str());
 
 	myfile.setf(std::ios_base::fixed, std::ios_base::floatfield);
@@ -364,6 +395,8 @@ void SBF::SaveToDisk(const std::string path, int mode)
     }
 
     myfile.close();
+
+    SBF_PROBE2(save__return, path.c_str(), mode);
 }
 
 
@@ -377,98 +410,92 @@ void SBF::SaveToDisk(const std::string path, int mode)
 // int area         the area label
 void SBF::Insert(const char *string, const int size, const int area)
 {
-    char* buffer = new char[size];
-
-    // We allow a maximum SBF mapping of 32 bit (resulting in 2^32 cells).
-    // Thus, the hash digest is limited to the first four bytes.
-    unsigned char digest32[SBF::MAX_BYTE_MAPPING];
+    SBF_PROBE2(insert__entry, size, area);
+#if defined(SBF_INSTRUMENTATION) || defined(SBF_USDT)
+    int collisions = this->collisions;
+#endif
+#ifdef SBF_INSTRUMENTATION
+    std::chrono::steady_clock::time_point start;
+    if (this->instrumentation != NULL) start = std::chrono::steady_clock::now();
+#endif
 
+    char* buffer = new char[size];
     unsigned char* digest = new unsigned char[this->HASH_digest_length];
 
     // Computes the hash digest of the input 'HASH_number' times; each
     // iteration combines the input char array with a different hash salt
     for(int k=0; k<this->HASH_number; k++){
 
-        for(int j=0; j<size; j++){
-            buffer[j] = (char)(string[j]^this->HASH_salt[k][j]);
-        }
-
-        this->Hash(buffer, size, (unsigned char*)digest);
-
-        // Truncates the digest after the first 32 bits (see above)
-        for(int i = 0; i < SBF::MAX_BYTE_MAPPING; i++){
-             digest32[i] = digest[i];
-        }
-
-        // Copies the truncated digest (one byte at a time) in an integer
-        // variable (endian independent)
-		unsigned int digest_index;
-		if (this->BIG_end) {
-			digest_index = (digest32[0] << 24) | (digest32[1] << 16) | (digest32[2] << 8) | digest32[3];
-		}
-		else
-		{
-			digest_index = (digest32[3] << 24) | (digest32[2] << 16) | (digest32[1] << 8) | digest32[0];
-		}
-        
+        unsigned int digest_index = this->salts->Digest32(string, size, k, buffer, digest);
 
         // Shifts bits in order to preserve only the first 'bit_mapping'
         // least significant bits
         digest_index >>= (SBF::MAX_BIT_MAPPING - this->bit_mapping);
 
         this->SetCell(digest_index, area);
+        if (this->recorder != NULL) this->recorder->AddIndex(digest_index);
 
     }
 
     this->members++;
     this->AREA_members[area]++;
+    if (this->recorder != NULL) this->recorder->AddMember(area);
+    this->version.fetch_add(1, std::memory_order_release);
 
 	delete[] buffer;
 	delete[] digest;
+
+#ifdef SBF_INSTRUMENTATION
+    if (this->instrumentation != NULL) this->instrumentation->RecordInsert(ElapsedNs(start), this->collisions - collisions, this->HASH_number);
+#endif
+
+    SBF_PROBE3(insert__return, size, area, this->collisions - collisions);
 }
 
 // Verifies weather the input element belongs to one of the mapped sets.
 // Returns the area label (i.e. the identifier of the set) if the element
-// belongs to a set, 0 otherwise.
+// belongs to a set, 0 otherwise. If the cache is enabled (see EnableCache),
+// elements checked since the last insertion are answered without hashing.
 // char *string     the element to be verified
 // int size         length of the element
 int SBF::Check(const char *string, const int size) const
 {
+    SBF_PROBE1(check__entry, size);
+
+#ifdef SBF_INSTRUMENTATION
+    std::chrono::steady_clock::time_point start;
+    if (this->instrumentation != NULL) start = std::chrono::steady_clock::now();
+#endif
+
+    // The version is read before the cells, so that a result computed
+    // while an insertion is in progress is stored as already stale
+    uint64_t fingerprint = 0;
+    unsigned long long version = 0;
+    if (this->cache != NULL) {
+        int cached;
+        fingerprint = this->cache->Fingerprint(string, size);
+        version = this->version.load(std::memory_order_acquire);
+        if (this->cache->Lookup(fingerprint, version, &cached)) {
+#ifdef SBF_INSTRUMENTATION
+            if (this->instrumentation != NULL) this->instrumentation->RecordCheck(ElapsedNs(start), cached, false, 0);
+#endif
+            SBF_PROBE3(check__return, size, cached, 0);
+            return cached;
+        }
+    }
+
     char* buffer = new char[size];
     int area = 0;
     int current_area = 0;
-
-    // We allow a maximum SBF mapping of 32 bit (resulting in 2^32 cells).
-    // Thus, the hash digest is limited to the first four bytes.
-    unsigned char digest32[SBF::MAX_BYTE_MAPPING];
+    int k;
 
     unsigned char* digest = new unsigned char[this->HASH_digest_length];
 
     // Computes the hash digest of the input 'HASH_number' times; each
     // iteration combines the input char array with a different hash salt
-    for(int k=0; k<this->HASH_number; k++){
-
-        for(int j=0; j<size; j++){
-            buffer[j] = (char)(string[j]^this->HASH_salt[k][j]);
-        }
-
-        this->Hash(buffer, size, (unsigned char*)digest);
-
-        // Truncates the digest to the first 32 bits
-        for(int i = 0; i < SBF::MAX_BYTE_MAPPING; i++){
-             digest32[i] = digest[i];
-        }
+    for(k=0; k<this->HASH_number; k++){
 
-		// Copies the truncated digest (one byte at a time) in an integer
-		// variable (endian independent)
-		unsigned int digest_index;
-		if (this->BIG_end) {
-			digest_index = (digest32[0] << 24) | (digest32[1] << 16) | (digest32[2] << 8) | digest32[3];
-		}
-		else
-		{
-			digest_index = (digest32[3] << 24) | (digest32[2] << 16) | (digest32[1] << 8) | digest32[0];
-		}
+        unsigned int digest_index = this->salts->Digest32(string, size, k, buffer, digest);
 
         // Shifts bits in order to preserve only the first 'bit_mapping' least
         // significant bits
@@ -478,7 +505,10 @@ int SBF::Check(const char *string, const int size) const
 
         // If one hash points to an empty cell, the element does not belong
         // to any set.
-        if(current_area==0) return 0;
+        if(current_area==0){
+            area = 0;
+            break;
+        }
         // Otherwise, stores the lower area label, among those which were returned
         else if(area == 0) area = current_area;
         else if(current_area < area) area = current_area;
@@ -486,15 +516,302 @@ int SBF::Check(const char *string, const int size) const
 
 	delete[] buffer;
 	delete[] digest;
+
+    if (this->cache != NULL) this->cache->Store(fingerprint, version, area);
+
+#ifdef SBF_INSTRUMENTATION
+    // k is the index of the digest pointing to an empty cell, if any
+    if (this->instrumentation != NULL) this->instrumentation->RecordCheck(ElapsedNs(start), area, k < this->HASH_number - 1, (k < this->HASH_number) ? k + 1 : k);
+#endif
+
+    SBF_PROBE3(check__return, size, area, (k < this->HASH_number) ? k + 1 : k);
     return area;
 }
 
 
+// Computes the 'HASH_number' truncated 32-bit digests of the input element,
+// without reducing them to the filter size. Since the digests do not depend
+// on bit_mapping, they can be computed before the final size of the filter is
+// known and mapped later through InsertDigests and CheckDigests.
+// Throws std::invalid_argument if the element is longer than MAX_INPUT_SIZE.
+// char *string            the element to be hashed
+// int size                length of the element
+// unsigned int *digests   output array of (at least) HASH_number digests
+void SBF::Digest(const char *string, const int size, unsigned int *digests) const
+{
+    this->salts->Digest(string, size, digests);
+
+#ifdef SBF_INSTRUMENTATION
+    if (this->instrumentation != NULL) this->instrumentation->RecordHashCalls(this->HASH_number);
+#endif
+}
+
+
+// Maps an element to the SBF given its 'HASH_number' digests (as produced by
+// Digest). Same ordering requirements as Insert apply.
+// unsigned int *digests   the element digests
+// int area                the area label
+void SBF::InsertDigests(const unsigned int *digests, const int area)
+{
+    for(int k=0; k<this->HASH_number; k++){
+        unsigned int index = digests[k] >> (SBF::MAX_BIT_MAPPING - this->bit_mapping);
+        this->SetCell(index, area);
+        if (this->recorder != NULL) this->recorder->AddIndex(index);
+    }
+
+    this->members++;
+    this->AREA_members[area]++;
+    if (this->recorder != NULL) this->recorder->AddMember(area);
+    this->version.fetch_add(1, std::memory_order_release);
+}
+
+
+// Verifies an element given its 'HASH_number' digests (as produced by
+// Digest). Returns the area label, or 0 if the element is not mapped.
+// unsigned int *digests   the element digests
+int SBF::CheckDigests(const unsigned int *digests) const
+{
+    int area = 0;
+    int current_area;
+
+    for(int k=0; k<this->HASH_number; k++){
+        current_area = this->GetCell(digests[k] >> (SBF::MAX_BIT_MAPPING - this->bit_mapping));
+
+        if(current_area==0) return 0;
+        else if(area == 0) area = current_area;
+        else if(current_area < area) area = current_area;
+    }
+
+    return area;
+}
+
+
+// Verifies an element given its 'HASH_number' cell indices (as recorded by
+// an InsertionRecorder). Returns the area label, or 0 if the element is not
+// mapped.
+// unsigned int *indices   the element cell indices
+int SBF::CheckIndices(const unsigned int *indices) const
+{
+    int area = 0;
+    int current_area;
+
+    for(int k=0; k<this->HASH_number; k++){
+        current_area = this->GetCell(indices[k]);
+
+        if(current_area==0) return 0;
+        else if(area == 0 || current_area < area) area = current_area;
+    }
+
+    return area;
+}
+
+
+// Verifies whether the input element belongs to the given area, i.e.
+// whether Check would return area. As Check returns the lowest label among
+// the 'HASH_number' cells, hashing stops at the first cell holding a lower
+// label (or empty), so that non-members and elements of lower areas are
+// rejected after few digests on average.
+// char *string     the element to be verified
+// int size         length of the element
+// int area         the area label
+bool SBF::CheckArea(const char *string, const int size, const int area) const
+{
+    char* buffer = new char[size];
+    unsigned char* digest = new unsigned char[this->HASH_digest_length];
+
+    int result = this->CheckThreshold(string, size, (area > 1) ? area : 1, buffer, digest);
+
+	delete[] buffer;
+	delete[] digest;
+
+    return result == area;
+}
+
+
+// Verifies whether the input element belongs to one of the given areas.
+// Returns the area label Check would return if it is one of them, 0
+// otherwise. Hashing stops at the first cell holding a label lower than
+// all of the given areas.
+// char *string     the element to be verified
+// int size         length of the element
+// int *areas       the area labels
+// int count        number of area labels
+int SBF::CheckAnyOf(const char *string, const int size, const int *areas, const int count) const
+{
+    if (count <= 0) return 0;
+
+    int threshold = areas[0];
+    for (int i = 1; i < count; i++) {
+        if (areas[i] < threshold) threshold = areas[i];
+    }
+
+    char* buffer = new char[size];
+    unsigned char* digest = new unsigned char[this->HASH_digest_length];
+
+    int result = this->CheckThreshold(string, size, (threshold > 1) ? threshold : 1, buffer, digest);
+
+	delete[] buffer;
+	delete[] digest;
+
+    for (int i = 0; i < count; i++) {
+        if (areas[i] == result && result != 0) return result;
+    }
+    return 0;
+}
+
+
+// Batch version of CheckArea, split among threads (0 for all those of the
+// executor, see parallel.h). Each thread processes its elements in blocks
+// of CHECK_BLOCK, one hash round at a time (see CheckBlock), so that the
+// elements still undecided after each round are kept together. Throws
+// std::invalid_argument if an element is longer than MAX_INPUT_SIZE.
+// char **strings   the elements to be verified
+// int *sizes       lengths of the elements
+// long long count  number of elements
+// int area         the area label
+// bool *results    output results (count entries)
+void SBF::CheckArea(const char *const *strings, const int *sizes, const long long count, const int area, bool *results, const int threads) const
+{
+    CheckSizes(sizes, count);
+
+    ParallelFor(threads, count, [&](int, long long begin, long long end) {
+        std::vector<int> block_areas(SBF::CHECK_BLOCK);
+        std::vector<int> undecided(SBF::CHECK_BLOCK);
+        std::vector<char> buffer(SBF::MAX_INPUT_SIZE);
+        std::vector<unsigned char> digest(this->HASH_digest_length);
+
+        for (long long first = begin; first < end; first += SBF::CHECK_BLOCK) {
+            int block = (end - first < SBF::CHECK_BLOCK) ? (int)(end - first) : SBF::CHECK_BLOCK;
+            this->CheckBlock(strings + first, sizes + first, block, (area > 1) ? area : 1, &block_areas[0], &undecided[0], &buffer[0], &digest[0]);
+            for (int i = 0; i < block; i++) results[first + i] = (block_areas[i] == area);
+        }
+    });
+}
+
+
+// Batch version of CheckAnyOf, processed as the batch CheckArea.
+// char **strings   the elements to be verified
+// int *sizes       lengths of the elements
+// long long count  number of elements
+// int *areas       the area labels
+// int area_count   number of area labels
+// int *results     output area labels, or 0 (count entries)
+void SBF::CheckAnyOf(const char *const *strings, const int *sizes, const long long count, const int *areas, const int area_count, int *results, const int threads) const
+{
+    CheckSizes(sizes, count);
+
+    // Labels looked up by value, out of range ones being ignored
+    std::vector<char> wanted(this->AREA_number + 1, 0);
+    int threshold = 0;
+    for (int i = 0; i < area_count; i++) {
+        if (areas[i] < 1 || areas[i] > this->AREA_number) continue;
+        wanted[areas[i]] = 1;
+        if (threshold == 0 || areas[i] < threshold) threshold = areas[i];
+    }
+
+    if (threshold == 0) {
+        for (long long i = 0; i < count; i++) results[i] = 0;
+        return;
+    }
+
+    ParallelFor(threads, count, [&](int, long long begin, long long end) {
+        std::vector<int> undecided(SBF::CHECK_BLOCK);
+        std::vector<char> buffer(SBF::MAX_INPUT_SIZE);
+        std::vector<unsigned char> digest(this->HASH_digest_length);
+
+        for (long long first = begin; first < end; first += SBF::CHECK_BLOCK) {
+            int block = (end - first < SBF::CHECK_BLOCK) ? (int)(end - first) : SBF::CHECK_BLOCK;
+            this->CheckBlock(strings + first, sizes + first, block, threshold, results + first, &undecided[0], &buffer[0], &digest[0]);
+            for (int i = 0; i < block; i++) {
+                if (!wanted[results[first + i]]) results[first + i] = 0;
+            }
+        }
+    });
+}
+
+
+// Counts how many of the input elements Check maps to each area, without
+// storing the result of each element: every thread tallies its elements
+// (checked in blocks, as by the batch CheckArea) into its own histogram,
+// and the histograms are then summed in parallel over the areas.
+// With sample_rate below 1, each element is counted with that probability,
+// drawn from seed and its position in the batch, so that the sample (and
+// the counts) do not depend on the number of threads; dividing the counts
+// by sample_rate estimates those of the whole batch.
+// Returns the number of elements checked. Throws std::invalid_argument if
+// sample_rate is out of range or an element is longer than MAX_INPUT_SIZE.
+// char **strings       the elements to be verified
+// int *sizes           lengths of the elements
+// long long count      number of elements
+// long long *counts    output counts per area label, 0 being the
+//                      non-members (AREA_number+1 entries)
+// double sample_rate   fraction of the elements to be checked, in (0, 1]
+// unsigned long long seed  seed of the sample
+long long SBF::CountByArea(const char *const *strings, const int *sizes, const long long count, long long *counts, const int threads, const double sample_rate, const unsigned long long seed) const
+{
+    if (!(sample_rate > 0 && sample_rate <= 1)) throw std::invalid_argument("Invalid sample rate.");
+    CheckSizes(sizes, count);
+
+    int parts = ThreadCount(threads);
+    int labels = this->AREA_number + 1;
+    std::vector<std::vector<long long> > histograms(parts);
+    std::vector<long long> sampled(parts, 0);
+
+    // Elements with a draw below the threshold are counted
+    bool sampling = (sample_rate < 1);
+    uint64_t threshold = (uint64_t)(sample_rate * 18446744073709551616.0);
+
+    ParallelFor(parts, count, [&](int t, long long begin, long long end) {
+        std::vector<long long> &histogram = histograms[t];
+        std::vector<const char*> block_strings(SBF::CHECK_BLOCK);
+        std::vector<int> block_sizes(SBF::CHECK_BLOCK);
+        std::vector<int> block_areas(SBF::CHECK_BLOCK);
+        std::vector<int> undecided(SBF::CHECK_BLOCK);
+        std::vector<char> buffer(SBF::MAX_INPUT_SIZE);
+        std::vector<unsigned char> digest(this->HASH_digest_length);
+
+        histogram.assign(labels, 0);
+
+        long long i = begin;
+        while (i < end) {
+            int block = 0;
+            for (; i < end && block < SBF::CHECK_BLOCK; i++) {
+                if (sampling && Mix64(seed + (uint64_t)i * 0x9E3779B97F4A7C15ULL) >= threshold) continue;
+                block_strings[block] = strings[i];
+                block_sizes[block] = sizes[i];
+                block++;
+            }
+
+            this->CheckBlock(&block_strings[0], &block_sizes[0], block, 1, &block_areas[0], &undecided[0], &buffer[0], &digest[0]);
+            for (int j = 0; j < block; j++) histogram[block_areas[j]]++;
+            sampled[t] += block;
+        }
+    });
+
+    // Parallel reduction, each thread summing a range of areas
+    ParallelFor(parts, labels, [&](int, long long begin, long long end) {
+        for (long long a = begin; a < end; a++) {
+            long long sum = 0;
+            for (int t = 0; t < parts; t++) {
+                if (!histograms[t].empty()) sum += histograms[t][a];
+            }
+            counts[a] = sum;
+        }
+    });
+
+    long long checked = 0;
+    for (int t = 0; t < parts; t++) checked += sampled[t];
+    return checked;
+}
+
+
 // Computes a-priori area-specific inter-set error probability (a_priori_isep)
 // Computes a-priori area-specific safeness probability (a_priori_safep) and
 // the overall safeness probability for the entire filter
 void SBF::SetAPrioriAreaIsep()
 {
+	SBF_PROBE1(stats__entry, "SetAPrioriAreaIsep");
+
 	double p1, p2, p3;
 	int nfill;
 
@@ -523,12 +840,15 @@ void SBF::SetAPrioriAreaIsep()
 
 	this->safeness = (float)p3;
 
+	SBF_PROBE1(stats__return, "SetAPrioriAreaIsep");
 }
 
 
 // Computes a-posteriori area-specific inter-set error probability (isep)
 void SBF::SetAreaIsep()
 {
+	SBF_PROBE1(stats__entry, "SetAreaIsep");
+
 	double p;
 
 	for (int i = this->AREA_number; i>0; i--) {
@@ -539,12 +859,16 @@ void SBF::SetAreaIsep()
 		this->AREA_isep[i] = (float)p;
 
 	}
+
+	SBF_PROBE1(stats__return, "SetAreaIsep");
 }
 
 
 // Computes the expected number of cells for each area (expected_cells)
 void SBF::SetExpectedAreaCells()
 {
+	SBF_PROBE1(stats__entry, "SetExpectedAreaCells");
+
 	double p1, p2;
 	int nfill;
 
@@ -565,12 +889,16 @@ void SBF::SetExpectedAreaCells()
 		this->AREA_expected_cells[i] = (int)round(p1);
 
 	}
+
+	SBF_PROBE1(stats__return, "SetExpectedAreaCells");
 }
 
 
 // Computes a-priori area-specific false positives probability (a_priori_fpp)
 void SBF::SetAPrioriAreaFpp()
 {
+	SBF_PROBE1(stats__entry, "SetAPrioriAreaFpp");
+
 	double p;
 	int c;
 
@@ -592,12 +920,16 @@ void SBF::SetAPrioriAreaFpp()
 		}
 		if (AREA_a_priori_fpp[i]<0) AREA_a_priori_fpp[i] = 0;
 	}
+
+	SBF_PROBE1(stats__return, "SetAPrioriAreaFpp");
 }
 
 
 // Computes a-posteriori area-specific false positives probability (fpp)
 void SBF::SetAreaFpp()
 {
+    SBF_PROBE1(stats__entry, "SetAreaFpp");
+
     double p;
     int c;
 
@@ -618,6 +950,8 @@ void SBF::SetAreaFpp()
         }
         if(AREA_fpp[i]<0) AREA_fpp[i]=0;
     }
+
+    SBF_PROBE1(stats__return, "SetAreaFpp");
 }
 
 
@@ -628,6 +962,182 @@ int SBF::GetAreaMembers(const int area) const
 }
 
 
+// Returns the exponent defining the number of cells (2^bit_mapping)
+int SBF::GetBitMapping() const
+{
+	return this->bit_mapping;
+}
+
+
+// Returns the hash function identifier (see the SBF constructor)
+int SBF::GetHashFamily() const
+{
+	return this->HASH_family;
+}
+
+
+// Returns the number of digests computed for each element
+int SBF::GetHashNumber() const
+{
+	return this->HASH_number;
+}
+
+
+// Returns the number of mapped areas
+int SBF::GetAreaNumber() const
+{
+	return this->AREA_number;
+}
+
+
+// Returns the overall number of inserted elements
+int SBF::GetMembers() const
+{
+	return this->members;
+}
+
+
+// Copies the area labels of count cells, starting from the cell at index
+// first, into areas (e.g. to encrypt the filter cell by cell)
+void SBF::ReadCells(const unsigned int first, const int count, int *areas) const
+{
+	for (int i = 0; i < count; i++) {
+		areas[i] = this->GetCell(first + i);
+	}
+}
+
+
+// Starts collecting Insert and Check counters and latencies (see
+// instrument.h). Returns false if the library was built without
+// SBF_INSTRUMENTATION, in which case nothing is collected.
+bool SBF::EnableInstrumentation()
+{
+#ifdef SBF_INSTRUMENTATION
+	if (this->instrumentation == NULL) this->instrumentation = new Instrumentation(this->AREA_number, this->HASH_number);
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+// Returns a snapshot of the counters collected since EnableInstrumentation
+// (an empty snapshot if instrumentation is not enabled)
+InstrumentationSnapshot SBF::GetInstrumentation() const
+{
+	if (this->instrumentation == NULL) return InstrumentationSnapshot();
+	return this->instrumentation->GetSnapshot();
+}
+
+
+// Starts counting the SetCell and GetCell accesses per region of
+// region_bytes bytes of the cell array, one access in sample_period (see
+// CellHeatmap in instrument.h); a heatmap already enabled is kept as is.
+// Returns false if the library was built without SBF_INSTRUMENTATION or the
+// settings are not positive.
+bool SBF::EnableHeatmap(const int region_bytes, const int sample_period)
+{
+#ifdef SBF_INSTRUMENTATION
+	if (region_bytes < 1 || sample_period < 1) return false;
+	if (this->heatmap == NULL) this->heatmap = new CellHeatmap(this->cells, this->cell_size, region_bytes, sample_period);
+	return true;
+#else
+	(void)region_bytes;
+	(void)sample_period;
+	return false;
+#endif
+}
+
+
+// Returns the cell access counts collected since EnableHeatmap (an empty
+// snapshot if the heatmap is not enabled)
+HeatmapSnapshot SBF::GetHeatmap() const
+{
+	if (this->heatmap == NULL) return HeatmapSnapshot();
+	return this->heatmap->GetSnapshot();
+}
+
+
+// Starts recording the cell indices of the inserted elements (see
+// record.h). Elements inserted before the call are not recorded.
+void SBF::EnableRecorder()
+{
+	if (this->recorder == NULL) this->recorder = new InsertionRecorder(this->bit_mapping, this->HASH_number);
+}
+
+
+// Returns the record of the inserted elements, or NULL if not enabled
+const InsertionRecorder *SBF::GetRecorder() const
+{
+	return this->recorder;
+}
+
+
+// Stops recording and discards the record
+void SBF::ReleaseRecorder()
+{
+	delete this->recorder;
+	this->recorder = NULL;
+}
+
+
+// Puts a cache of slots entries in front of Check (see CheckCache in
+// cache.h); a cache already enabled is kept as is. Must not be called
+// together with Check. Returns false if slots is not positive.
+bool SBF::EnableCache(const int slots)
+{
+	if (slots <= 0) return false;
+	if (this->cache == NULL) this->cache = new CheckCache(slots);
+	return true;
+}
+
+
+// Returns the Check cache, or NULL if not enabled
+const CheckCache *SBF::GetCache() const
+{
+	return this->cache;
+}
+
+
+// Removes the Check cache. Must not be called together with Check.
+void SBF::DisableCache()
+{
+	delete this->cache;
+	this->cache = NULL;
+}
+
+
+// Returns the filter version, incremented by each insertion
+unsigned long long SBF::GetVersion() const
+{
+	return this->version.load(std::memory_order_acquire);
+}
+
+
+// Returns the memory footprint of the filter (see memusage.h). The resident
+// part of the cell array is measured, so the call touches no cells but may
+// take time proportional to the number of pages for large filters.
+MemoryUsage SBF::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+
+	usage.object = sizeof(SBF);
+	usage.cells = (size_t)this->size;
+	usage.cells_mapped = MappedBytes((size_t)this->size, this->filter_mapped);
+	usage.cells_resident = ResidentBytes(this->filter, (size_t)this->size, this->filter_mapped);
+	usage.salts = this->salts->GetBytes();
+	usage.areas = (size_t)(this->AREA_number + 1) * (4 * sizeof(int) + 5 * sizeof(float));
+	usage.instrumentation = (this->instrumentation == NULL) ? 0 : this->instrumentation->GetBytes();
+	if (this->heatmap != NULL) usage.instrumentation += this->heatmap->GetBytes();
+	usage.recorder = (this->recorder == NULL) ? 0 : this->recorder->GetBytes();
+	usage.cache = (this->cache == NULL) ? 0 : this->cache->GetBytes();
+	usage.scratch = SBF::MAX_INPUT_SIZE + this->HASH_digest_length;
+	usage.filters = 1;
+
+	return usage;
+}
+
+
 // Returns the sparsity of the entire SBF
 float SBF::GetFilterSparsity() const
 {
@@ -707,4 +1217,4 @@ float SBF::GetAreaEmersion(const int area) const
 
 
 
-} //namespace sbf
\ No newline at end of file
+} //namespace sbf
\ No newline at end of file
@@ -37,8 +37,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "linux/libexport.h"
 #endif
 
-#include "end.h"
+#include "cache.h"
+#include "instrument.h"
+#include "memusage.h"
+#include "record.h"
+#include "salt.h"
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <math.h>
@@ -56,7 +61,8 @@ namespace sbf {
 
 	private:
 		BYTE *filter;
-		BYTE ** HASH_salt;
+		int filter_mapped;
+		HashSalt *salts;
 		int bit_mapping;
 		int cells;
 		int cell_size;
@@ -77,21 +83,23 @@ namespace sbf {
 		float *AREA_a_priori_isep;
 		float *AREA_isep;
 		float *AREA_a_priori_safep;
-		int BIG_end;
+		Instrumentation *instrumentation;
+		CellHeatmap *heatmap;
+		InsertionRecorder *recorder;
+		CheckCache *cache;
+		std::atomic<unsigned long long> version;
 
 		// Private methods (commented in the sbf.cpp)
 		void SetCell(unsigned int index, int area);
 		int GetCell(unsigned int index) const;
-		void CreateHashSalt(std::string path);
-		void LoadHashSalt(std::string path);
-		void SetHashDigestLength();
-		void Hash(char *d, size_t n, unsigned char *md) const;
+		int CheckThreshold(const char *string, int size, int threshold, char *buffer, unsigned char *digest) const;
+		void CheckBlock(const char *const *strings, const int *sizes, int count, int threshold, int *areas, int *undecided, char *buffer, unsigned char *digest) const;
 
 
 	public:
 		// The maximum string (as a char array) length in bytes of each element
 		// given as input to be mapped in the SBF
-		const static int MAX_INPUT_SIZE = 128;
+		const static int MAX_INPUT_SIZE = HashSalt::MAX_INPUT_SIZE;
 		// This value defines the maximum size (as in number of cells) of the SBF:
 		// MAX_BIT_MAPPING = 32 states that the SBF will be composed at most by
 		// 2^32 cells. The value is the number of bits used for SBF indexing.
@@ -103,6 +111,9 @@ namespace sbf {
 		const static int MAX_AREA_NUMBER = 65535;
 		// The maximum number of allowed digests
 		const static int MAX_HASH_NUMBER = 1024;
+		// The number of elements the batch CheckArea and CheckAnyOf process
+		// together, one hash round at a time
+		const static int CHECK_BLOCK = 1024;
 
 		// SBF class constructor
 		// Arguments:
@@ -133,9 +144,6 @@ namespace sbf {
 			if (HASH_number <= 0 || HASH_number > MAX_HASH_NUMBER) throw std::invalid_argument("Invalid number of hash runs.");
 			if (salt_path.length() == 0) throw std::invalid_argument("Invalid hash salt path.");
 
-			// Checks whether the execution is being performed on a big endian or little endian machine
-			this->BIG_end = is_big_endian();
-
 			// Defines the number of bytes required for each cell depending on AREA_number
 			// In order to reduce the memory footprint of the filter, we use 1 byte 
 			// for a number of areas <= 255, 2 bytes for a up to MAX_AREA_NUMBER
@@ -145,20 +153,12 @@ namespace sbf {
 
 			// Sets the type of hash function to be used
 			this->HASH_family = HASH_family;
-			this->SetHashDigestLength();
 			// Sets the number of digests
 			this->HASH_number = HASH_number;
 
-			// Initializes the HASH_salt matrix
-			this->HASH_salt = new BYTE*[HASH_number];
-			for (int j = 0; j<HASH_number; j++) {
-				this->HASH_salt[j] = new BYTE[SBF::MAX_INPUT_SIZE];
-			}
-
 			// Creates the hash salts or loads them from the specified file
-			std::ifstream my_file(salt_path.c_str());
-			if (my_file.good()) this->LoadHashSalt(salt_path);
-			else this->CreateHashSalt(salt_path);
+			this->salts = new HashSalt(HASH_family, HASH_number, salt_path);
+			this->HASH_digest_length = this->salts->GetDigestLength();
 
 			// Defines the number of cells in the filter
 			this->cells = (int)pow(2, bit_mapping);
@@ -167,13 +167,9 @@ namespace sbf {
 			// Defines the total size in bytes of the filter
 			this->size = this->cell_size*this->cells;
 
-			// Memory allocation for the SBF array
-			this->filter = new BYTE[this->size];
-
-			// Initializes the cells to 0
-			for (int i = 0; i < this->size; i++) {
-				this->filter[i] = 0;
-			}
+			// Memory allocation for the SBF array, with the cells initialized
+			// to 0 (large filters are mapped as demand-zero pages)
+			this->filter = AllocateCells(this->size, this->filter_mapped);
 
 			// Sets the number of mapped areas
 			this->AREA_number = AREA_number;
@@ -189,6 +185,11 @@ namespace sbf {
 			this->AREA_a_priori_safep = new float[this->AREA_number + 1];
 
 			// Parameter initializations
+			this->instrumentation = NULL;
+			this->heatmap = NULL;
+			this->recorder = NULL;
+			this->cache = NULL;
+			this->version = 0;
 			this->members = 0;
 			this->collisions = 0;
 			for (int a = 0; a < this->AREA_number + 1; a++) {
@@ -202,13 +203,17 @@ namespace sbf {
 				this->AREA_a_priori_isep[a] = -1;
 				this->AREA_a_priori_safep[a] = -1;
 			}
+
+			MemoryRegistry::Register(this);
 		}
 
 		// SBF class destructor
 		~SBF()
 		{
+			MemoryRegistry::Unregister(this);
+
 			// Frees the allocated memory
-			delete[] filter;
+			FreeCells(filter, size, filter_mapped);
 			delete[] AREA_members;
 			delete[] AREA_cells;
 			delete[] AREA_expected_cells;
@@ -218,10 +223,11 @@ namespace sbf {
 			delete[] AREA_a_priori_fpp;
 			delete[] AREA_a_priori_isep;
 			delete[] AREA_a_priori_safep;
-			for (int j = 0; j<this->HASH_number; j++) {
-				delete[] HASH_salt[j];
-			}
-			delete[] HASH_salt;
+			delete salts;
+			delete instrumentation;
+			delete heatmap;
+			delete recorder;
+			delete cache;
 		}
 
 
@@ -230,6 +236,33 @@ namespace sbf {
 		void SaveToDisk(const std::string path, int mode);
 		void Insert(const char *string, const int size, const int area);
 		int Check(const char *string, const int size) const;
+		void Digest(const char *string, const int size, unsigned int *digests) const;
+		void InsertDigests(const unsigned int *digests, const int area);
+		int CheckDigests(const unsigned int *digests) const;
+		int CheckIndices(const unsigned int *indices) const;
+		bool CheckArea(const char *string, const int size, const int area) const;
+		int CheckAnyOf(const char *string, const int size, const int *areas, const int count) const;
+		void CheckArea(const char *const *strings, const int *sizes, const long long count, const int area, bool *results, const int threads = 0) const;
+		void CheckAnyOf(const char *const *strings, const int *sizes, const long long count, const int *areas, const int area_count, int *results, const int threads = 0) const;
+		long long CountByArea(const char *const *strings, const int *sizes, const long long count, long long *counts, const int threads = 0, const double sample_rate = 1, const unsigned long long seed = 0) const;
+		int GetBitMapping() const;
+		int GetHashFamily() const;
+		int GetHashNumber() const;
+		int GetAreaNumber() const;
+		int GetMembers() const;
+		void ReadCells(const unsigned int first, const int count, int *areas) const;
+		bool EnableInstrumentation();
+		InstrumentationSnapshot GetInstrumentation() const;
+		bool EnableHeatmap(const int region_bytes = 4096, const int sample_period = 1);
+		HeatmapSnapshot GetHeatmap() const;
+		void EnableRecorder();
+		const InsertionRecorder *GetRecorder() const;
+		void ReleaseRecorder();
+		bool EnableCache(const int slots = 65536);
+		const CheckCache *GetCache() const;
+		void DisableCache();
+		unsigned long long GetVersion() const;
+		MemoryUsage GetMemoryUsage() const;
 		int GetAreaMembers(const int area) const;
 		float GetFilterSparsity() const;
 		float GetFilterFpp() const;
@@ -245,4 +278,4 @@ namespace sbf {
 
 } //namespace sbf
 
-#endif /* SBF_H */
\ No newline at end of file
+#endif /* SBF_H */
\ No newline at end of file
@@ -0,0 +1,358 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define SBF_DLL
+
+#include "simulate.h"
+#include "memusage.h"
+#include "parallel.h"
+#include "planner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <math.h>
+#include <stdexcept>
+#include <stdint.h>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// Outcome of a single trial, per area: final cells, distinct cells written
+// (the emersion denominator), and members suffering an inter-set error
+struct Trial
+{
+    std::vector<long long> cells;
+    std::vector<long long> written;
+    std::vector<long long> ise;
+};
+
+
+// SplitMix64 finalizer, turning a counter into a random 64-bit value
+inline uint64_t Mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+
+// Runs a trial over a cell array of type T (uint8_t or uint16_t, as the
+// filter cell size). first[a] is the index of the first member of area a,
+// over all the areas; the j-th cell of member e is drawn from the counter
+// e * HASH_number + j.
+template <typename T>
+void RunTrial(const std::vector<long long> &first, const int bit_mapping, const int HASH_number, const uint64_t key, const int threads, Trial &trial)
+{
+    static_assert(sizeof(std::atomic<T>) == sizeof(T), "Lock-free cells required");
+
+    const int AREA_number = (int)first.size() - 2;
+    const long long cells = 1LL << bit_mapping;
+    const int shift = 64 - bit_mapping;
+    const int parts = ThreadCount(threads);
+
+    int mapped;
+    unsigned char *buffer = AllocateCells((size_t)cells * sizeof(T), mapped);
+    std::atomic<T> *array = (std::atomic<T>*)buffer;
+
+    trial.cells.assign(AREA_number + 1, 0);
+    trial.written.assign(AREA_number + 1, 0);
+    trial.ise.assign(AREA_number + 1, 0);
+
+    // Insertion, in ascending order of areas. Members of the same area may
+    // be inserted concurrently: a cell is written by the first of them, and
+    // counts as a self-collision for the others
+    std::vector<long long> written(parts);
+    for (int a = 1; a <= AREA_number; a++) {
+        long long members = first[a + 1] - first[a];
+        std::fill(written.begin(), written.end(), 0);
+
+        ParallelFor(members * HASH_number >= (1 << 16) ? parts : 1, members, [&](int t, long long begin, long long end) {
+            long long count = 0;
+            for (long long e = first[a] + begin; e < first[a] + end; e++) {
+                for (int j = 0; j < HASH_number; j++) {
+                    uint64_t index = Mix(key + (uint64_t)(e * HASH_number + j)) >> shift;
+                    T old = array[index].load(std::memory_order_relaxed);
+                    while (old < (T)a && !array[index].compare_exchange_weak(old, (T)a, std::memory_order_relaxed)) {}
+                    if (old < (T)a) count++;
+                }
+            }
+            written[t] = count;
+        });
+
+        for (int t = 0; t < parts; t++) trial.written[a] += written[t];
+    }
+
+    // Checks: a member suffers an inter-set error if all its cells were
+    // overwritten by higher areas; then the cells of each area are counted
+    std::vector<std::vector<long long> > counts(parts);
+    ParallelFor(parts, first[AREA_number + 1], [&](int t, long long begin, long long end) {
+        std::vector<long long> &ise = counts[t];
+        ise.assign(AREA_number + 1, 0);
+        int a = (int)(std::upper_bound(first.begin() + 1, first.end(), begin) - first.begin()) - 1;
+        for (long long e = begin; e < end; e++) {
+            while (e >= first[a + 1]) a++;
+            T min = (T)SBF::MAX_AREA_NUMBER;
+            for (int j = 0; j < HASH_number; j++) {
+                T value = array[Mix(key + (uint64_t)(e * HASH_number + j)) >> shift].load(std::memory_order_relaxed);
+                if (value < min) min = value;
+            }
+            if (min != (T)a) ise[a]++;
+        }
+    });
+    for (int t = 0; t < parts; t++) {
+        for (size_t a = 0; a < counts[t].size(); a++) trial.ise[a] += counts[t][a];
+    }
+
+    ParallelFor(parts, cells, [&](int t, long long begin, long long end) {
+        std::vector<long long> &histogram = counts[t];
+        histogram.assign(AREA_number + 1, 0);
+        for (long long i = begin; i < end; i++) histogram[array[i].load(std::memory_order_relaxed)]++;
+    });
+    for (int t = 0; t < parts; t++) {
+        for (size_t a = 0; a < counts[t].size(); a++) trial.cells[a] += counts[t][a];
+    }
+
+    FreeCells(buffer, (size_t)cells * sizeof(T), mapped);
+}
+
+
+// Sets the mean and the 95% confidence interval (normal approximation) of
+// the samples
+void Estimate(const std::vector<double> &samples, SimulatedValue &value)
+{
+    double n = (double)samples.size(), sum = 0, squares = 0;
+    for (size_t i = 0; i < samples.size(); i++) sum += samples[i];
+    value.mean = sum / n;
+    for (size_t i = 0; i < samples.size(); i++) squares += (samples[i] - value.mean) * (samples[i] - value.mean);
+
+    double margin = (n > 1) ? 1.96 * sqrt(squares / (n - 1) / n) : 0;
+    value.low = value.mean - margin;
+    value.high = value.mean + margin;
+}
+
+
+// Sets the frequency and the 95% Wilson score interval of the successes
+// over the trials
+void EstimateProportion(const long long successes, const int trials, SimulatedValue &value)
+{
+    const double z = 1.96;
+    double n = (double)trials, p = (double)successes / n;
+    double center = (p + z * z / (2 * n)) / (1 + z * z / n);
+    double margin = z * sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / (1 + z * z / n);
+
+    value.mean = p;
+    value.low = center - margin;
+    value.high = center + margin;
+}
+
+
+void WriteValue(std::ofstream &file, const SimulatedValue &value)
+{
+    file << ";" << value.expected << ";" << value.mean << ";" << value.low << ";" << value.high;
+}
+
+} //namespace
+
+
+/* ***************************** PUBLIC METHODS ***************************** */
+
+
+SimulatedValue::SimulatedValue()
+{
+    this->mean = -1;
+    this->low = -1;
+    this->high = -1;
+    this->expected = -1;
+}
+
+
+SimulationReport::SimulationReport()
+{
+    this->trials = 0;
+    this->bit_mapping = 0;
+    this->HASH_number = 0;
+    this->AREA_number = 0;
+}
+
+
+// Saves the report as CSV: the filter values as "name;expected;mean;low;high"
+// lines, then one line per area with the same four columns for each value
+void SimulationReport::SaveToDisk(const std::string path) const
+{
+    std::ofstream file(path.c_str());
+    if (!file.is_open()) throw std::runtime_error("Unable to open file " + path);
+
+    file << "trials;" << this->trials << std::endl;
+    file << "bit_mapping;" << this->bit_mapping << std::endl;
+    file << "hash number;" << this->HASH_number << std::endl;
+    file << "fpp";
+    WriteValue(file, this->fpp);
+    file << std::endl << "safeness probability";
+    WriteValue(file, this->safeness);
+    file << std::endl;
+
+    const char *names[] = { "fpp", "isep", "safep", "emersion", "cells" };
+    file << "area";
+    for (int v = 0; v < 5; v++) {
+        file << ";expected " << names[v] << ";" << names[v] << ";" << names[v] << " low;" << names[v] << " high";
+    }
+    file << std::endl;
+
+    for (int a = 1; a <= this->AREA_number; a++) {
+        file << a;
+        WriteValue(file, this->AREA_fpp[a]);
+        WriteValue(file, this->AREA_isep[a]);
+        WriteValue(file, this->AREA_safep[a]);
+        WriteValue(file, this->AREA_emersion[a]);
+        WriteValue(file, this->AREA_cells[a]);
+        file << std::endl;
+    }
+}
+
+
+// AREA_members[a] is the number of elements of area a (index 0 is unused).
+// threads = 0 uses the available hardware threads.
+Simulator::Simulator(const std::vector<long long> &AREA_members, int threads)
+{
+    int AREA_number = (int)AREA_members.size() - 1;
+    if (AREA_number <= 0 || AREA_number > SBF::MAX_AREA_NUMBER) throw std::invalid_argument("Invalid number of areas.");
+    for (int a = 1; a <= AREA_number; a++) {
+        if (AREA_members[a] < 0) throw std::invalid_argument("Invalid number of members.");
+    }
+
+    this->AREA_members = AREA_members;
+    this->AREA_members[0] = 0;
+    this->threads = ThreadCount(threads);
+}
+
+
+// Simulates trials constructions of a filter with 2^bit_mapping cells and
+// HASH_number digests per element. The per-trial fpp is the exact fpp of the
+// simulated filter (the fraction of non-empty cells to the power of
+// HASH_number, split by area as SetAreaFpp), so that its mean estimates the
+// a-priori fpp without sampling non-members; isep, emersion and cells are
+// per-trial ratios and counts; safeness and safep are the fraction of
+// trials without inter-set errors. The closed-form values come from the
+// Planner. Equal seeds give equal results.
+SimulationReport Simulator::Run(const int bit_mapping, const int HASH_number, const int trials, const unsigned long long seed) const
+{
+    if (bit_mapping <= 0 || bit_mapping > SBF::MAX_BIT_MAPPING) throw std::invalid_argument("Invalid bit mapping.");
+    if (HASH_number <= 0 || HASH_number > SBF::MAX_HASH_NUMBER) throw std::invalid_argument("Invalid number of hash runs.");
+    if (trials <= 0) throw std::invalid_argument("Invalid number of trials.");
+
+    const int AREA_number = (int)this->AREA_members.size() - 1;
+    std::vector<long long> first(AREA_number + 2, 0);
+    for (int a = 1; a <= AREA_number; a++) first[a + 1] = first[a] + this->AREA_members[a];
+
+    // Trials run concurrently when their cell arrays are small
+    std::vector<Trial> results(trials);
+    const bool concurrent = (1LL << bit_mapping) <= Simulator::PARALLEL_TRIAL_CELLS;
+    auto run = [&](int, long long begin, long long end) {
+        for (long long i = begin; i < end; i++) {
+            uint64_t key = Mix(seed ^ Mix((uint64_t)i));
+            int threads = concurrent ? 1 : this->threads;
+            if (AREA_number <= 255) RunTrial<uint8_t>(first, bit_mapping, HASH_number, key, threads, results[i]);
+            else RunTrial<uint16_t>(first, bit_mapping, HASH_number, key, threads, results[i]);
+        }
+    };
+    if (concurrent) ParallelFor(this->threads, trials, run);
+    else run(0, 0, trials);
+
+    SimulationReport report;
+    report.trials = trials;
+    report.bit_mapping = bit_mapping;
+    report.HASH_number = HASH_number;
+    report.AREA_number = AREA_number;
+    report.AREA_fpp.resize(AREA_number + 1);
+    report.AREA_isep.resize(AREA_number + 1);
+    report.AREA_safep.resize(AREA_number + 1);
+    report.AREA_emersion.resize(AREA_number + 1);
+    report.AREA_cells.resize(AREA_number + 1);
+
+    const double cells = ldexp(1.0, bit_mapping);
+    std::vector<double> samples(trials);
+    std::vector<double> above(trials, 0);
+
+    // Filter fpp: all the non-empty cells
+    for (int i = 0; i < trials; i++) samples[i] = pow((cells - (double)results[i].cells[0]) / cells, HASH_number);
+    Estimate(samples, report.fpp);
+
+    long long safe = 0;
+    for (int i = 0; i < trials; i++) {
+        long long ise = 0;
+        for (int a = 1; a <= AREA_number; a++) ise += results[i].ise[a];
+        if (ise == 0) safe++;
+    }
+    EstimateProportion(safe, trials, report.safeness);
+
+    // Per-area values, from the highest area down (as SetAreaFpp)
+    std::vector<long long> filled(trials, 0);
+    for (int a = AREA_number; a > 0; a--) {
+        for (int i = 0; i < trials; i++) {
+            filled[i] += results[i].cells[a];
+            double p = pow((double)filled[i] / cells, HASH_number);
+            samples[i] = p - above[i];
+            above[i] = p;
+        }
+        Estimate(samples, report.AREA_fpp[a]);
+
+        if (this->AREA_members[a] > 0) {
+            for (int i = 0; i < trials; i++) samples[i] = (double)results[i].ise[a] / (double)this->AREA_members[a];
+            Estimate(samples, report.AREA_isep[a]);
+            for (int i = 0; i < trials; i++) samples[i] = (double)results[i].cells[a] / (double)results[i].written[a];
+            Estimate(samples, report.AREA_emersion[a]);
+        }
+
+        for (int i = 0; i < trials; i++) samples[i] = (double)results[i].cells[a];
+        Estimate(samples, report.AREA_cells[a]);
+
+        safe = 0;
+        for (int i = 0; i < trials; i++) {
+            if (results[i].ise[a] == 0) safe++;
+        }
+        EstimateProportion(safe, trials, report.AREA_safep[a]);
+    }
+
+    // Closed-form values
+    if (first[AREA_number + 1] > 0) {
+        FilterPlan plan = Planner(this->AREA_members).Evaluate(bit_mapping, HASH_number);
+        report.fpp.expected = plan.fpp;
+        report.safeness.expected = plan.safeness;
+        for (int a = 1; a <= AREA_number; a++) {
+            report.AREA_fpp[a].expected = plan.AREA_a_priori_fpp[a];
+            report.AREA_isep[a].expected = plan.AREA_a_priori_isep[a];
+            report.AREA_safep[a].expected = plan.AREA_a_priori_safep[a];
+            report.AREA_emersion[a].expected = exp((double)HASH_number * (double)(first[AREA_number + 1] - first[a + 1]) * log1p(-1 / cells));
+            report.AREA_cells[a].expected = plan.AREA_expected_cells[a];
+        }
+    }
+
+    return report;
+}
+
+} //namespace sbf
@@ -0,0 +1,104 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include "sbf.h"
+
+#include <string>
+#include <vector>
+
+
+namespace sbf {
+
+	// A simulated quantity: the mean over the trials, the bounds of its 95%
+	// confidence interval, and the closed-form (a-priori) value it estimates
+	struct DLL_PUBLIC SimulatedValue
+	{
+		double mean;
+		double low;
+		double high;
+		double expected;
+
+		SimulatedValue();
+	};
+
+
+	// Results of a Monte Carlo simulation (see the Simulator class)
+	struct DLL_PUBLIC SimulationReport
+	{
+		int trials;
+		int bit_mapping;
+		int HASH_number;
+		int AREA_number;
+		// Filter fpp and safeness probability (see GetFilterAPrioriFpp and
+		// SetAPrioriAreaIsep)
+		SimulatedValue fpp;
+		SimulatedValue safeness;
+		// Per-area values, indexed by area label (index 0 unused): fpp, ratio
+		// of members suffering an inter-set error, safeness probability,
+		// emersion and number of cells
+		std::vector<SimulatedValue> AREA_fpp;
+		std::vector<SimulatedValue> AREA_isep;
+		std::vector<SimulatedValue> AREA_safep;
+		std::vector<SimulatedValue> AREA_emersion;
+		std::vector<SimulatedValue> AREA_cells;
+
+		SimulationReport();
+
+		void SaveToDisk(const std::string path) const;
+	};
+
+
+	// Monte Carlo simulator of the filter construction, used to validate the
+	// a-priori statistics of configurations too large to be built with real
+	// data. Hashing is skipped: each element is given HASH_number uniformly
+	// random cell indices, drawn from a counter-based generator so that they
+	// can be drawn again for the checks instead of being stored. Each trial
+	// fills a fresh cell array area by area, in ascending order of labels,
+	// then checks every member (inter-set errors) and counts the cells of
+	// each area. Small filters run one trial per thread; filters larger
+	// than PARALLEL_TRIAL_CELLS run the trials one at a time, each one split
+	// among the threads.
+	class DLL_PUBLIC Simulator
+	{
+
+	private:
+		std::vector<long long> AREA_members;
+		int threads;
+
+	public:
+		// Cell count above which the trials are run one at a time
+		const static long long PARALLEL_TRIAL_CELLS = 1LL << 22;
+
+		Simulator(const std::vector<long long> &AREA_members, int threads);
+
+		// Public methods (commented in the simulate.cpp)
+		SimulationReport Run(const int bit_mapping, const int HASH_number, const int trials, const unsigned long long seed) const;
+	};
+
+} //namespace sbf
+
+#endif /* SIMULATE_H */
@@ -0,0 +1,759 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define SBF_DLL
+
+#include "spatial.h"
+#include "dataset.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <fstream>
+#include <math.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <utility>
+
+
+namespace sbf {
+
+/* ******************************** HELPERS ******************************** */
+
+namespace {
+
+// Minimal recursive descent parser for WKT polygons
+class WktParser
+{
+public:
+    WktParser(const std::string &text) : text(text), pos(0) {}
+
+    std::vector<SpatialPolygon> Parse()
+    {
+        std::vector<SpatialPolygon> polygons;
+        std::string keyword = this->Keyword();
+
+        if (keyword == "POLYGON") {
+            if (!this->Empty()) polygons.push_back(this->Polygon());
+        }
+        else if (keyword == "MULTIPOLYGON") {
+            if (!this->Empty()) {
+                this->Expect('(');
+                do {
+                    polygons.push_back(this->Polygon());
+                } while (this->Accept(','));
+                this->Expect(')');
+            }
+        }
+        else {
+            throw std::invalid_argument("Unsupported WKT geometry: " + keyword);
+        }
+
+        this->Skip();
+        if (this->pos != this->text.size()) throw std::invalid_argument("Invalid WKT polygon.");
+        return polygons;
+    }
+
+private:
+    const std::string &text;
+    size_t pos;
+
+    void Skip()
+    {
+        while (this->pos < this->text.size() && isspace((unsigned char)this->text[this->pos])) this->pos++;
+    }
+
+    bool Accept(char c)
+    {
+        this->Skip();
+        if (this->pos < this->text.size() && this->text[this->pos] == c) {
+            this->pos++;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c)
+    {
+        if (!this->Accept(c)) throw std::invalid_argument("Invalid WKT polygon.");
+    }
+
+    std::string Keyword()
+    {
+        this->Skip();
+        std::string keyword;
+        while (this->pos < this->text.size() && isalpha((unsigned char)this->text[this->pos])) {
+            keyword += (char)toupper((unsigned char)this->text[this->pos++]);
+        }
+        return keyword;
+    }
+
+    // Consumes an EMPTY geometry, or an optional Z / M / ZM dimension tag
+    bool Empty()
+    {
+        std::string keyword = this->Keyword();
+        if (keyword == "EMPTY") return true;
+        if (keyword != "" && keyword != "Z" && keyword != "M" && keyword != "ZM") throw std::invalid_argument("Invalid WKT polygon.");
+        return false;
+    }
+
+    double Number()
+    {
+        this->Skip();
+        const char *begin = this->text.c_str() + this->pos;
+        char *end;
+        double value = strtod(begin, &end);
+        if (end == begin) throw std::invalid_argument("Invalid WKT polygon.");
+        this->pos += (size_t)(end - begin);
+        return value;
+    }
+
+    // A ring: points of two (or more, the extra ones being ignored)
+    // coordinates
+    std::vector<SpatialPoint> Ring()
+    {
+        std::vector<SpatialPoint> ring;
+        this->Expect('(');
+        do {
+            SpatialPoint point;
+            point.x = this->Number();
+            point.y = this->Number();
+            this->Skip();
+            while (this->pos < this->text.size() && this->text[this->pos] != ',' && this->text[this->pos] != ')') this->Number();
+            ring.push_back(point);
+        } while (this->Accept(','));
+        this->Expect(')');
+        return ring;
+    }
+
+    SpatialPolygon Polygon()
+    {
+        SpatialPolygon polygon;
+        this->Expect('(');
+        do {
+            polygon.rings.push_back(this->Ring());
+        } while (this->Accept(','));
+        this->Expect(')');
+        return polygon;
+    }
+};
+
+
+// Returns the first grid line (column or row) whose center is at or after
+// coordinate v, clamped to [0, limit]
+int FirstCenter(double v, double origin, double size, int limit)
+{
+    double line = ceil((v - origin) / size - 0.5);
+    if (line < 0) return 0;
+    if (line > limit) return limit;
+    return (int)line;
+}
+
+
+// Hashes the keys of count grid cells in parallel batches and inserts them
+// in order, with the given area labels (all 1 when areas is NULL)
+void InsertCells(SBF *filter, const long long *cells, const int *areas, const long long total, const int threads)
+{
+    const int HASH_number = filter->GetHashNumber();
+    std::vector<unsigned int> digests((size_t)SpatialIngest::BATCH_CELLS * HASH_number);
+
+    for (long long base = 0; base < total; base += SpatialIngest::BATCH_CELLS) {
+        long long count = (total - base < SpatialIngest::BATCH_CELLS) ? total - base : SpatialIngest::BATCH_CELLS;
+
+        ParallelFor(threads, count, [&](int, long long begin, long long end) {
+            char key[GridDefinition::KEY_SIZE];
+            for (long long i = begin; i < end; i++) {
+                GridDefinition::Key(cells[base + i], key);
+                filter->Digest(key, GridDefinition::KEY_SIZE, &digests[(size_t)(i * HASH_number)]);
+            }
+        });
+
+        for (long long i = 0; i < count; i++) {
+            filter->InsertDigests(&digests[(size_t)(i * HASH_number)], (areas != NULL) ? areas[base + i] : 1);
+        }
+    }
+}
+
+} //namespace
+
+
+/* **************************** GRID METHODS ******************************* */
+
+
+GridDefinition::GridDefinition()
+{
+    this->min_x = 0;
+    this->min_y = 0;
+    this->cell_width = 1;
+    this->cell_height = 1;
+    this->columns = 0;
+    this->rows = 0;
+}
+
+
+// Returns the identifier of the grid cell containing the point (x, y), or
+// -1 if the point is outside the grid
+long long GridDefinition::GetCellId(double x, double y) const
+{
+    double column = floor((x - this->min_x) / this->cell_width);
+    double row = floor((y - this->min_y) / this->cell_height);
+    if (!(column >= 0 && column < this->columns && row >= 0 && row < this->rows)) return -1;
+    return (long long)row * this->columns + (long long)column;
+}
+
+
+// Writes the binary key of a grid cell (KEY_SIZE bytes) into key
+void GridDefinition::Key(long long cell, char *key)
+{
+    for (int b = GridDefinition::KEY_SIZE - 1; b >= 0; b--) {
+        key[b] = (char)(cell & 0xFF);
+        cell >>= 8;
+    }
+}
+
+
+/* *************************** PUBLIC METHODS ****************************** */
+
+
+SpatialIngest::SpatialIngest(const GridDefinition &grid, int threads)
+{
+    if (grid.columns <= 0 || grid.rows <= 0 || !(grid.cell_width > 0) || !(grid.cell_height > 0)) {
+        throw std::invalid_argument("Invalid grid definition.");
+    }
+
+    this->grid = grid;
+    this->threads = ThreadCount(threads);
+    this->AREA_number = 0;
+}
+
+
+// Adds a polygon covering the given area (labels start from 1)
+void SpatialIngest::AddPolygon(const int area, const SpatialPolygon &polygon)
+{
+    if (area < 1) throw std::invalid_argument("Invalid area label.");
+
+    this->polygons.push_back(polygon);
+    this->polygon_areas.push_back(area);
+    if (area > this->AREA_number) this->AREA_number = area;
+}
+
+
+// Adds a polygon without holes, given as an array of points x1, y1, x2, y2...
+void SpatialIngest::AddPolygon(const int area, const double *coordinates, const int points)
+{
+    SpatialPolygon polygon;
+    polygon.rings.resize(1);
+    for (int i = 0; i < points; i++) {
+        SpatialPoint point;
+        point.x = coordinates[2 * i];
+        point.y = coordinates[2 * i + 1];
+        polygon.rings[0].push_back(point);
+    }
+    this->AddPolygon(area, polygon);
+}
+
+
+// Adds the polygons of a WKT POLYGON or MULTIPOLYGON
+void SpatialIngest::AddWkt(const int area, const std::string &wkt)
+{
+    std::vector<SpatialPolygon> parsed = SpatialIngest::ParseWkt(wkt);
+    for (size_t p = 0; p < parsed.size(); p++) this->AddPolygon(area, parsed[p]);
+}
+
+
+// Adds the polygons listed in a file, one "area<delimiter>WKT" per line
+// (e.g. 3,POLYGON((0 0, 10 0, 10 10, 0 10))). Empty lines and lines
+// starting with # are skipped.
+void SpatialIngest::LoadFromDisk(const std::string &path, const char delimiter)
+{
+    std::ifstream myfile(path.c_str());
+    if (!myfile.is_open()) throw std::runtime_error("Unable to open file " + path);
+
+    std::string line;
+    while (getline(myfile, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.empty() || line[0] == '#') continue;
+
+        const char *wkt;
+        int length;
+        int area = ParseLine(line.c_str(), line.size(), delimiter, wkt, length);
+        this->AddWkt(area, std::string(wkt, length));
+    }
+}
+
+
+// Rasterizes all the polygons: computes the grid cells covered by each area,
+// sorted by area label and cell, without duplicates within an area.
+// Returns the number of (area, cell) pairs.
+long long SpatialIngest::Rasterize()
+{
+    const GridDefinition &grid = this->grid;
+
+    // Each polygon contributes the grid rows whose center falls within its
+    // vertical extent; the rows of all the polygons are split among threads
+    std::vector<long long> first(this->polygons.size() + 1, 0);
+    std::vector<int> first_row(this->polygons.size(), 0);
+    for (size_t p = 0; p < this->polygons.size(); p++) {
+        double min_y = 0, max_y = 0;
+        bool empty = true;
+        for (size_t r = 0; r < this->polygons[p].rings.size(); r++) {
+            const std::vector<SpatialPoint> &ring = this->polygons[p].rings[r];
+            for (size_t i = 0; i < ring.size(); i++) {
+                if (empty || ring[i].y < min_y) min_y = ring[i].y;
+                if (empty || ring[i].y > max_y) max_y = ring[i].y;
+                empty = false;
+            }
+        }
+        int begin = empty ? 0 : FirstCenter(min_y, grid.min_y, grid.cell_height, grid.rows);
+        int end = empty ? 0 : FirstCenter(max_y, grid.min_y, grid.cell_height, grid.rows);
+        first_row[p] = begin;
+        first[p + 1] = first[p] + (end - begin);
+    }
+
+    int threads = ThreadCount(this->threads);
+    std::vector<std::vector<std::pair<int, long long> > > covered(threads);
+
+    ParallelFor(threads, first[this->polygons.size()], [&](int t, long long begin, long long end) {
+        std::vector<std::pair<int, long long> > &out = covered[t];
+        std::vector<double> crossings;
+
+        size_t p = std::upper_bound(first.begin(), first.end(), begin) - first.begin() - 1;
+        for (long long item = begin; item < end; item++) {
+            while (item >= first[p + 1]) p++;
+            int row = first_row[p] + (int)(item - first[p]);
+            double y = grid.min_y + (row + 0.5) * grid.cell_height;
+
+            // Crossings of the row center line with the edges of all the
+            // rings (half-open in y, so that shared vertices count once)
+            crossings.clear();
+            const SpatialPolygon &polygon = this->polygons[p];
+            for (size_t r = 0; r < polygon.rings.size(); r++) {
+                const std::vector<SpatialPoint> &ring = polygon.rings[r];
+                for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+                    const SpatialPoint &a = ring[j];
+                    const SpatialPoint &b = ring[i];
+                    if ((a.y <= y && b.y > y) || (b.y <= y && a.y > y)) {
+                        crossings.push_back(a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y));
+                    }
+                }
+            }
+            std::sort(crossings.begin(), crossings.end());
+
+            // Cells whose center lies between pairs of crossings are inside
+            for (size_t c = 0; c + 1 < crossings.size(); c += 2) {
+                int from = FirstCenter(crossings[c], grid.min_x, grid.cell_width, grid.columns);
+                int to = FirstCenter(crossings[c + 1], grid.min_x, grid.cell_width, grid.columns);
+                for (int column = from; column < to; column++) {
+                    out.push_back(std::make_pair(this->polygon_areas[p], (long long)row * grid.columns + column));
+                }
+            }
+        }
+    });
+
+    std::vector<std::pair<int, long long> > all;
+    size_t total = 0;
+    for (int t = 0; t < threads; t++) total += covered[t].size();
+    all.reserve(total);
+    for (int t = 0; t < threads; t++) {
+        all.insert(all.end(), covered[t].begin(), covered[t].end());
+        std::vector<std::pair<int, long long> >().swap(covered[t]);
+    }
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+
+    this->areas.resize(all.size());
+    this->cells.resize(all.size());
+    for (size_t i = 0; i < all.size(); i++) {
+        this->areas[i] = all[i].first;
+        this->cells[i] = all[i].second;
+    }
+
+    return (long long)this->cells.size();
+}
+
+
+// Inserts the rasterized grid cells into the filter, in ascending order of
+// area label. The keys are hashed in parallel, BATCH_CELLS at a time.
+void SpatialIngest::Insert(SBF *filter) const
+{
+    if (this->AREA_number > filter->GetAreaNumber()) throw std::invalid_argument("The filter has fewer areas than the polygons.");
+
+    InsertCells(filter, this->cells.data(), this->areas.data(), (long long)this->cells.size(), this->threads);
+}
+
+
+// Builds a filter holding the rasterized grid cells (Rasterize must have
+// been called), sized as by the streaming ingestion (see IngestOptions;
+// threads, delimiter and the dataset hints are not used). Returns the
+// filter, to be deleted by the caller.
+SBF* SpatialIngest::Build(const IngestOptions &options) const
+{
+    if (this->cells.empty()) throw std::runtime_error("No grid cell is covered by the polygons.");
+    if (options.max_fpp <= 0 || options.max_fpp >= 1) throw std::invalid_argument("Invalid false positives probability.");
+    if (options.salt_path.length() == 0) throw std::invalid_argument("Invalid hash salt path.");
+
+    int HASH_number = (options.HASH_number > 0) ? options.HASH_number : Ingest::HashNumber(options.max_fpp);
+    int bit_mapping = (options.bit_mapping > 0) ? options.bit_mapping : Ingest::BitMapping((long long)this->cells.size(), options.max_fpp);
+
+    SBF *filter = new SBF(bit_mapping, options.HASH_family, HASH_number, this->AREA_number, options.salt_path);
+    this->Insert(filter);
+    return filter;
+}
+
+
+// Returns the number of rasterized (area, grid cell) pairs
+long long SpatialIngest::GetCells() const
+{
+    return (long long)this->cells.size();
+}
+
+
+// Returns the highest area label of the polygons
+int SpatialIngest::GetAreaNumber() const
+{
+    return this->AREA_number;
+}
+
+
+// Returns the area labels of the rasterized grid cells (see GetCellIds)
+const int *SpatialIngest::GetAreas() const
+{
+    return this->areas.empty() ? NULL : &this->areas[0];
+}
+
+
+// Returns the identifiers of the rasterized grid cells, in insertion order
+const long long *SpatialIngest::GetCellIds() const
+{
+    return this->cells.empty() ? NULL : &this->cells[0];
+}
+
+
+// Parses a WKT POLYGON or MULTIPOLYGON (extra Z or M coordinates are
+// ignored)
+std::vector<SpatialPolygon> SpatialIngest::ParseWkt(const std::string &wkt)
+{
+    WktParser parser(wkt);
+    return parser.Parse();
+}
+
+
+
+/* *************************** CHECKER METHODS ***************************** */
+
+
+SpatialChecker::SpatialChecker(const SBF *filter, const GridDefinition &grid, int threads)
+{
+    if (grid.columns <= 0 || grid.rows <= 0 || !(grid.cell_width > 0) || !(grid.cell_height > 0)) {
+        throw std::invalid_argument("Invalid grid definition.");
+    }
+
+    this->filter = filter;
+    this->grid = grid;
+    this->threads = ThreadCount(threads);
+    this->last_cell = -2;
+    this->last_area = 0;
+    this->checks = 0;
+    this->hashed = 0;
+}
+
+
+// Checks the key of a grid cell (-1, outside the grid, is in no area). The
+// last cell checked is -2 when there is none.
+int SpatialChecker::CheckCell(long long cell) const
+{
+    if (cell < 0) return 0;
+
+    char key[GridDefinition::KEY_SIZE];
+    GridDefinition::Key(cell, key);
+    return this->filter->Check(key, GridDefinition::KEY_SIZE);
+}
+
+
+// Returns the area of the point (x, y), as Check on the key of its grid
+// cell; the filter is only queried if the cell differs from the previous
+// point's
+int SpatialChecker::Check(const double x, const double y)
+{
+    long long cell = this->grid.GetCellId(x, y);
+    this->checks++;
+
+    if (cell != this->last_cell) {
+        this->last_area = this->CheckCell(cell);
+        this->last_cell = cell;
+        if (cell >= 0) this->hashed++;
+    }
+    return this->last_area;
+}
+
+
+// Checks count points, writing the area of each one into areas. The batch
+// is split among the threads; within each part, runs of consecutive points
+// in the same grid cell are checked once.
+void SpatialChecker::Check(const SpatialPoint *points, const long long count, int *areas)
+{
+    if (count <= 0) return;
+
+    const GridDefinition &grid = this->grid;
+    const long long previous_cell = this->last_cell;
+    const int previous_area = this->last_area;
+    std::vector<long long> hashed(ThreadCount(this->threads), 0);
+
+    ParallelFor(this->threads, count, [&](int t, long long begin, long long end) {
+        // The first part continues the run of the previous call
+        long long last = (t == 0) ? previous_cell : -2;
+        int area = previous_area;
+        for (long long i = begin; i < end; i++) {
+            long long cell = grid.GetCellId(points[i].x, points[i].y);
+            if (cell != last) {
+                area = this->CheckCell(cell);
+                last = cell;
+                if (cell >= 0) hashed[t]++;
+            }
+            areas[i] = area;
+        }
+    });
+
+    for (size_t t = 0; t < hashed.size(); t++) this->hashed += hashed[t];
+    this->checks += count;
+    this->last_cell = grid.GetCellId(points[count - 1].x, points[count - 1].y);
+    this->last_area = areas[count - 1];
+}
+
+
+// Same as above, for an array of coordinates x1, y1, x2, y2...
+void SpatialChecker::Check(const double *coordinates, const long long count, int *areas)
+{
+    static_assert(sizeof(SpatialPoint) == 2 * sizeof(double), "SpatialPoint must be a pair of coordinates");
+
+    this->Check((const SpatialPoint*)coordinates, count, areas);
+}
+
+
+// Returns the number of points checked so far
+long long SpatialChecker::GetChecks() const
+{
+    return this->checks;
+}
+
+
+// Returns the number of points which actually queried the filter (the
+// others repeated the grid cell of the previous point, or were outside the
+// grid)
+long long SpatialChecker::GetHashedCells() const
+{
+    return this->hashed;
+}
+
+
+// Forgets the last cell checked and resets the counters
+void SpatialChecker::Reset()
+{
+    this->last_cell = -2;
+    this->last_area = 0;
+    this->checks = 0;
+    this->hashed = 0;
+}
+
+
+/* ************************** HIERARCHY METHODS **************************** */
+
+
+SpatialHierarchy::SpatialHierarchy(const GridDefinition &grid, int levels, int factor, int threads)
+{
+    if (grid.columns <= 0 || grid.rows <= 0 || !(grid.cell_width > 0) || !(grid.cell_height > 0)) {
+        throw std::invalid_argument("Invalid grid definition.");
+    }
+    if (levels < 1 || levels > SpatialHierarchy::MAX_LEVELS) throw std::invalid_argument("Invalid number of levels.");
+    if (factor < 2) throw std::invalid_argument("Invalid refinement factor.");
+
+    this->grid = grid;
+    this->factor = factor;
+    this->threads = ThreadCount(threads);
+    this->levels.assign(levels, (SBF*)NULL);
+    this->scales.resize(levels);
+    this->columns.resize(levels);
+    this->probes.assign(levels, 0);
+
+    // Each level merges factor x factor cells of the level below; the
+    // coarsest levels stop growing once they are a single cell
+    long long scale = 1;
+    for (int l = 0; l < levels; l++) {
+        this->scales[l] = scale;
+        this->columns[l] = (grid.columns + scale - 1) / scale;
+        if (scale < grid.columns || scale < grid.rows) scale *= factor;
+    }
+}
+
+
+SpatialHierarchy::~SpatialHierarchy()
+{
+    for (size_t l = 0; l < this->levels.size(); l++) delete this->levels[l];
+}
+
+
+// Returns the identifier at the given level of the grid cell containing
+// the full resolution cell
+long long SpatialHierarchy::Ancestor(const long long cell, const int level) const
+{
+    long long row = cell / this->grid.columns;
+    long long column = cell % this->grid.columns;
+    return (row / this->scales[level]) * this->columns[level] + column / this->scales[level];
+}
+
+
+// Checks the full resolution cell from the coarsest level down, stopping at
+// the first level which reports no area. probes[l] counts the levels
+// queried.
+int SpatialHierarchy::CheckCell(const long long cell, long long *probes) const
+{
+    if (cell < 0) return 0;
+
+    char key[GridDefinition::KEY_SIZE];
+    for (int l = (int)this->levels.size() - 1; l > 0; l--) {
+        probes[l]++;
+        GridDefinition::Key(this->Ancestor(cell, l), key);
+        if (this->levels[l]->Check(key, GridDefinition::KEY_SIZE) == 0) return 0;
+    }
+
+    probes[0]++;
+    GridDefinition::Key(cell, key);
+    return this->levels[0]->Check(key, GridDefinition::KEY_SIZE);
+}
+
+
+// Builds all the levels from the grid cells rasterized by ingest (which
+// must use the same grid). The full resolution level holds the area labels
+// and is sized as by SpatialIngest::Build; every coarser level holds the
+// cells containing at least one rasterized cell, with label 1, and is sized
+// for options.max_fpp. All levels share the hash salts of options.salt_path.
+// Any previous level is discarded.
+void SpatialHierarchy::Build(const SpatialIngest &ingest, const IngestOptions &options)
+{
+    const long long total = ingest.GetCells();
+    if (total == 0) throw std::runtime_error("No grid cell is covered by the polygons.");
+    if (options.max_fpp <= 0 || options.max_fpp >= 1) throw std::invalid_argument("Invalid false positives probability.");
+    if (options.salt_path.length() == 0) throw std::invalid_argument("Invalid hash salt path.");
+
+    for (size_t l = 0; l < this->levels.size(); l++) {
+        delete this->levels[l];
+        this->levels[l] = NULL;
+    }
+
+    // The first filter creates the salt file if it does not exist yet, so
+    // that the coarser levels load the same salts
+    this->levels[0] = ingest.Build(options);
+
+    const long long *cells = ingest.GetCellIds();
+    std::vector<long long> coarse((size_t)total);
+    for (int l = 1; l < (int)this->levels.size(); l++) {
+        ParallelFor(this->threads, total, [&](int, long long begin, long long end) {
+            for (long long i = begin; i < end; i++) coarse[i] = this->Ancestor(cells[i], l);
+        });
+        std::vector<long long> unique(coarse);
+        std::sort(unique.begin(), unique.end());
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+        int bit_mapping = Ingest::BitMapping((long long)unique.size(), options.max_fpp);
+        this->levels[l] = new SBF(bit_mapping, options.HASH_family, this->levels[0]->GetHashNumber(), 1, options.salt_path);
+        InsertCells(this->levels[l], unique.data(), NULL, (long long)unique.size(), this->threads);
+    }
+}
+
+
+// Returns the area of the point (x, y), as Check on the key of its full
+// resolution grid cell, or 0 as soon as a coarser level rejects the point
+int SpatialHierarchy::Check(const double x, const double y)
+{
+    if (this->levels[0] == NULL) throw std::runtime_error("The hierarchy has not been built.");
+
+    return this->CheckCell(this->grid.GetCellId(x, y), this->probes.data());
+}
+
+
+// Checks count points, writing the area of each one into areas. The batch
+// is split among the threads.
+void SpatialHierarchy::Check(const SpatialPoint *points, const long long count, int *areas)
+{
+    if (this->levels[0] == NULL) throw std::runtime_error("The hierarchy has not been built.");
+    if (count <= 0) return;
+
+    const int levels = (int)this->levels.size();
+    std::vector<long long> probes((size_t)ThreadCount(this->threads) * levels, 0);
+
+    ParallelFor(this->threads, count, [&](int t, long long begin, long long end) {
+        long long *part = &probes[(size_t)t * levels];
+        for (long long i = begin; i < end; i++) {
+            areas[i] = this->CheckCell(this->grid.GetCellId(points[i].x, points[i].y), part);
+        }
+    });
+
+    for (size_t i = 0; i < probes.size(); i++) this->probes[i % levels] += probes[i];
+}
+
+
+// Returns the number of levels (the full resolution one included)
+int SpatialHierarchy::GetLevels() const
+{
+    return (int)this->levels.size();
+}
+
+
+// Returns the filter of the given level (0 is the full resolution one), or
+// NULL before Build
+const SBF *SpatialHierarchy::GetLevel(const int level) const
+{
+    if (level < 0 || level >= (int)this->levels.size()) throw std::out_of_range("Invalid level.");
+    return this->levels[level];
+}
+
+
+// Returns the grid of the given level: the cells of the full resolution
+// grid merged in blocks of factor^level x factor^level
+GridDefinition SpatialHierarchy::GetLevelGrid(const int level) const
+{
+    if (level < 0 || level >= (int)this->levels.size()) throw std::out_of_range("Invalid level.");
+
+    GridDefinition grid = this->grid;
+    grid.cell_width *= (double)this->scales[level];
+    grid.cell_height *= (double)this->scales[level];
+    grid.columns = (int)this->columns[level];
+    grid.rows = (int)((this->grid.rows + this->scales[level] - 1) / this->scales[level]);
+    return grid;
+}
+
+
+// Returns the number of queries which reached the given level (queries to
+// points outside the grid reach no level)
+long long SpatialHierarchy::GetProbes(const int level) const
+{
+    if (level < 0 || level >= (int)this->levels.size()) throw std::out_of_range("Invalid level.");
+    return this->probes[level];
+}
+
+
+// Resets the probe counters
+void SpatialHierarchy::ResetProbes()
+{
+    std::fill(this->probes.begin(), this->probes.end(), 0);
+}
+
+} //namespace sbf
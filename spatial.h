@@ -0,0 +1,202 @@
+/*
+Spatial Bloom Filter C++ Library (libSBF-cpp)
+Copyright (C) 2017  Luca Calderoni, Dario Maio,
+University of Bologna
+Copyright (C) 2017  Paolo Palmieri,
+Cranfield University
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include "sbf.h"
+#include "ingest.h"
+
+#include <string>
+#include <vector>
+
+
+namespace sbf {
+
+	// A point in grid coordinates (e.g. longitude and latitude)
+	struct DLL_PUBLIC SpatialPoint
+	{
+		double x;
+		double y;
+	};
+
+
+	// A polygon: an outer ring followed by any number of holes. Rings need
+	// not be closed (the last point is joined to the first one).
+	struct DLL_PUBLIC SpatialPolygon
+	{
+		std::vector<std::vector<SpatialPoint> > rings;
+	};
+
+
+	// A regular grid of columns x rows cells, the cell (0, 0) having its
+	// lower left corner at (min_x, min_y). Each grid cell is identified by
+	// row * columns + column, and mapped into the filter through a binary
+	// key: the identifier as an 8-byte big-endian number (see Key).
+	struct DLL_PUBLIC GridDefinition
+	{
+		double min_x;
+		double min_y;
+		double cell_width;
+		double cell_height;
+		int columns;
+		int rows;
+
+		GridDefinition();
+
+		long long GetCellId(double x, double y) const;
+		static void Key(long long cell, char *key);
+
+		// Length in bytes of a grid cell key
+		const static int KEY_SIZE = 8;
+	};
+
+
+	// Spatial ingestion: areas given as polygons (coordinate arrays or WKT
+	// POLYGON and MULTIPOLYGON) are rasterized over a grid, and the keys of
+	// the grid cells they cover are inserted into a filter, in ascending
+	// order of area label. A grid cell belongs to a polygon if its center
+	// lies inside it (even-odd rule, so holes are excluded). Polygons are
+	// rasterized in parallel scanline by scanline; the keys are hashed in
+	// parallel and inserted in order, without any string formatting.
+	class DLL_PUBLIC SpatialIngest
+	{
+
+	private:
+		GridDefinition grid;
+		int threads;
+		std::vector<SpatialPolygon> polygons;
+		std::vector<int> polygon_areas;
+		std::vector<int> areas;
+		std::vector<long long> cells;
+		int AREA_number;
+
+	public:
+		// Number of grid cells hashed per parallel batch during insertion
+		const static int BATCH_CELLS = 1 << 18;
+
+		SpatialIngest(const GridDefinition &grid, int threads);
+
+		// Public methods (commented in the spatial.cpp)
+		void AddPolygon(const int area, const SpatialPolygon &polygon);
+		void AddPolygon(const int area, const double *coordinates, const int points);
+		void AddWkt(const int area, const std::string &wkt);
+		void LoadFromDisk(const std::string &path, const char delimiter);
+		long long Rasterize();
+		void Insert(SBF *filter) const;
+		SBF* Build(const IngestOptions &options) const;
+		long long GetCells() const;
+		int GetAreaNumber() const;
+		const int *GetAreas() const;
+		const long long *GetCellIds() const;
+		static std::vector<SpatialPolygon> ParseWkt(const std::string &wkt);
+	};
+
+
+	// Coordinate-native queries: checks points (e.g. GPS fixes) against a
+	// filter built over a grid by SpatialIngest, computing the binary grid
+	// key of each point directly. Consecutive points falling into the same
+	// grid cell share a single Check, which removes most of the hashing for
+	// trajectories. Points outside the grid are reported as area 0.
+	// A SpatialChecker remembers the last cell checked, so it must not be
+	// used by several threads at once (batches are parallelized internally).
+	class DLL_PUBLIC SpatialChecker
+	{
+
+	private:
+		const SBF *filter;
+		GridDefinition grid;
+		int threads;
+		long long last_cell;
+		int last_area;
+		long long checks;
+		long long hashed;
+
+		int CheckCell(long long cell) const;
+
+	public:
+		SpatialChecker(const SBF *filter, const GridDefinition &grid, int threads);
+
+		// Public methods (commented in the spatial.cpp)
+		int Check(const double x, const double y);
+		void Check(const SpatialPoint *points, const long long count, int *areas);
+		void Check(const double *coordinates, const long long count, int *areas);
+		long long GetChecks() const;
+		long long GetHashedCells() const;
+		void Reset();
+	};
+
+
+	// Multi-resolution filters over the same grid and areas: level 0 is the
+	// full resolution filter built by SpatialIngest, and each level above
+	// merges factor x factor cells of the level below into one. Coarse
+	// levels only record whether a cell overlaps any area, so they are much
+	// smaller than level 0 and may stay in cache. A point is checked from
+	// the coarsest level down, and the full resolution filter is only
+	// queried if every coarser level reports a hit: points outside all the
+	// areas are usually rejected by the small filters.
+	// All levels are built from the same rasterization and share the hash
+	// salts. A coarse level never misses a covered cell, so the result is
+	// the same as Check on level 0, except for the false positives which the
+	// coarse levels happen to filter out.
+	class DLL_PUBLIC SpatialHierarchy
+	{
+
+	private:
+		GridDefinition grid;
+		int factor;
+		int threads;
+		std::vector<SBF*> levels;
+		std::vector<long long> scales;
+		std::vector<long long> columns;
+		std::vector<long long> probes;
+
+		// Private methods (commented in the spatial.cpp)
+		long long Ancestor(const long long cell, const int level) const;
+		int CheckCell(const long long cell, long long *probes) const;
+
+		// The filters are owned by the hierarchy
+		SpatialHierarchy(const SpatialHierarchy&);
+		SpatialHierarchy& operator=(const SpatialHierarchy&);
+
+	public:
+		// Maximum number of levels
+		const static int MAX_LEVELS = 16;
+
+		SpatialHierarchy(const GridDefinition &grid, int levels, int factor, int threads);
+		~SpatialHierarchy();
+
+		// Public methods (commented in the spatial.cpp)
+		void Build(const SpatialIngest &ingest, const IngestOptions &options);
+		int Check(const double x, const double y);
+		void Check(const SpatialPoint *points, const long long count, int *areas);
+		int GetLevels() const;
+		const SBF *GetLevel(const int level) const;
+		GridDefinition GetLevelGrid(const int level) const;
+		long long GetProbes(const int level) const;
+		void ResetProbes();
+	};
+
+} //namespace sbf
+
+#endif /* SPATIAL_H */
@@ -20,6 +20,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <sbflib.h>
+#include <ingest.h>
+#include <evaluate.h>
 
 #include <ctime>
 #include <iostream>
@@ -36,14 +38,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //of elements which don't belong to the filter at all.
 int main() {
 
-	std::ifstream myfile;
-	std::string line, a, member, path;
-	std::ofstream rate_file;
-	int len, line_count, area, area_check, n, narea, nver;
-	int well_recognised, false_positives, iser;
-	int* area_iser;
-	int* area_fp;
-	char* element;
 	sbf::SBF* myFilter = NULL;
 
 	/* ****************************** SETTINGS ****************************** */
@@ -74,10 +68,6 @@ int main() {
 	std::string hash_salt("SBFHashSalt" + buf + ".txt");
 
 
-	//the exponent that determines filter size (in cells)
-	int bit_mapping;
-	//the number of hash executions for each mapped element
-	int hn;
 	//hash function to be used
 	int hf = 4;
 
@@ -167,59 +157,23 @@ int main() {
 
 
 
-	//determines the number of elements and the number of areas depending on the
-	//chosen dataset
-	myfile.open(construction_dataset.c_str());
-	if (myfile.is_open()) {
-		line_count = 0;
-		while (getline(myfile, line)) {
-			++line_count;
-			a = line.substr(0, line.find(delimiter));
-			narea = atoi(a.c_str());
-		}
-		n = line_count;
-		myfile.close();
-	}
-	else {
-		printf("Unable to open file %s", construction_dataset.c_str());
-		exit(0);
-	}
+	//builds the filter reading the construction dataset once: the number of
+	//elements and areas, and thus the optimal bit_mapping, are estimated while
+	//streaming, and the hashed elements are buffered for the self-check
+	sbf::IngestOptions options;
+	options.HASH_family = hf;
+	options.max_fpp = max_fpp;
+	options.salt_path = hash_salt;
+	options.delimiter = delimiter[0];
+	sbf::Ingest ingest(options);
 
-	//determines the optimal bit_mapping and hash number
-	int cells = (int)ceil((double)((double)-n*log(max_fpp)) / pow(log(2), 2));
-	bit_mapping = (int)ceil(log2(cells));
-	hn = (int)ceil((double)(cells / n)*log(2));
-
-	//constructs the filter and fills it with elements contained in the
-	//input dataset
 	try {
-		//filter construction
-		myFilter = new sbf::SBF(bit_mapping, hf, hn, narea, hash_salt);
+		//filter construction and elements insertion
+		myFilter = ingest.Run(construction_dataset);
 	}
-	catch (const std::invalid_argument& ia)
+	catch (const std::exception& e)
 	{
-		std::cerr << ia.what() << std::endl;
-	}
-
-	myfile.open(construction_dataset.c_str());
-	if (myfile.is_open()) {
-		//elements insertion
-		for (int i = 0; i < n; ++i)
-		{
-			//reads one line
-			getline(myfile, line);
-			a = line.substr(0, line.find(delimiter));
-			area = atoi(a.c_str());
-			member = line.substr(line.find(delimiter) + 1);
-			len = member.length();
-			element = new char[len];
-			memcpy(element, member.c_str(), len);
-			myFilter->Insert(element, len, area);
-		}
-		myfile.close();
-	}
-	else {
-		printf("Unable to open file %s", construction_dataset.c_str());
+		std::cerr << e.what() << std::endl;
 		exit(0);
 	}
 
@@ -241,129 +195,36 @@ int main() {
 
 
 	//operates a self check upon the filter (i.e. runs the Check method for each
-	//of the already mapped elements)
-	well_recognised = 0, iser = 0;
-	area_iser = new int[narea+1];
-	for (int a = 0; a < narea + 1; a++) {
-		area_iser[a] = 0;
-	}
-	myfile.open(construction_dataset.c_str());
+	//of the already mapped elements, using the digests buffered by the ingestion)
+	sbf::Evaluator evaluator(myFilter, 0, delimiter[0]);
+	evaluator.SelfCheck(ingest.GetAreas(), ingest.GetDigests(), ingest.GetMembers());
+	ingest.ReleaseBuffer();
 
-	if (myfile.is_open()) {
-		printf("Self-check:\n");
-		for (int i = 0; i < n; i++)
-		{
-			//reads one line
-			getline(myfile, line);
-			a = line.substr(0, line.find(delimiter));
-			area = atoi(a.c_str());
-			member = line.substr(line.find(delimiter) + 1);
-			len = member.length();
-			element = new char[len];
-			memcpy(element, member.c_str(), len);
-			area_check = myFilter->Check(element, len);
-
-			if (area == area_check) well_recognised++;
-			else {
-				iser++;
-				area_iser[area]++;
-			}
+	printf("Self-check:\n");
+	printf("Elements assigned to the correct set: %lld\n", evaluator.GetReport().well_recognised);
+	printf("Inter-set errors: %lld\n", evaluator.GetReport().iser);
+	printf("Inter-set errors rate: %.5f\n", evaluator.GetReport().GetIserRate());
 
-		}
-		printf("Elements assigned to the correct set: %d\n", well_recognised);
-		printf("Inter-set errors: %d\n", iser);
-		printf("Inter-set errors rate: %.5f\n", (float)iser / (float)n);
-
-
-		if (print_mode == 3 || print_mode == 4) {
-		path = "ise" + buf + ".csv";
-		rate_file.open(path.c_str());
-		rate_file.setf(std::ios_base::fixed, std::ios_base::floatfield);
-		rate_file.precision(5);
-		// area-related parameters:
-		// area,inter-set errors,inter-set error rate
-		rate_file << "area" << ";" << "errors" << ";" << "rate" << std::endl;
-			for (int j = 1; j < narea + 1; j++) {
-				rate_file << j << ";" << area_iser[j] << ";" << (float)area_iser[j] / (float)myFilter->GetAreaMembers(j) << std::endl;
-			}
-			rate_file.close();
-		}
-
-		myfile.close();
-	}
-	else {
-		printf("Unable to open file %s", construction_dataset.c_str());
-		exit(0);
-	}
+	if (print_mode == 3 || print_mode == 4) evaluator.GetReport().SaveIseToDisk("ise" + buf + ".csv");
 
 	if (perform_verification) {
 
-		//determines the number of elements depending on the verification dataset
-		myfile.open(verification_dataset.c_str());
-
-		if (myfile.is_open()) {
-			line_count = 0;
-			while (getline(myfile, line)) {
-				++line_count;
-			}
-			nver = line_count;
-			myfile.close();
-		}
-		else {
-			printf("Unable to open file %s", verification_dataset.c_str());
-			exit(0);
-		}
-
 		//operates a verification using non members dataset
-		well_recognised = 0, false_positives = 0;
-		area_fp = new int[narea + 1];
-		for (int a = 0; a < narea + 1; a++) {
-			area_fp[a] = 0;
-		}
-		myfile.open(verification_dataset.c_str());
-
-		if (myfile.is_open()) {
-			printf("\nVerification (non-elements):\n");
-			for (int i = 0; i < nver; i++)
-			{
-				//reads one line
-				getline(myfile, line);
-				len = line.length();
-				element = new char[len];
-				memcpy(element, line.c_str(), len);
-				area = myFilter->Check(element, len);
-
-				if (area == 0) well_recognised++;
-				else
-				{
-					false_positives++;
-					area_fp[area]++;
-				}
-			}
-			printf("True negatives: %d\n", well_recognised);
-			printf("False positives: %d\n", false_positives);
-			printf("False positives rate: %.5f\n", (float)false_positives / (float)nver);
-
-			if (print_mode == 3 || print_mode == 4) {
-				path = "fp" + buf + ".csv";
-				rate_file.open(path.c_str());
-				rate_file.setf(std::ios_base::fixed, std::ios_base::floatfield);
-				rate_file.precision(5);
-				// area-related parameters:
-				// area,false positives,false positives rate
-				rate_file << "area" << ";" << "false positives" << ";" << "rate" << std::endl;
-				for (int j = 1; j < narea + 1; j++) {
-					rate_file << j << ";" << area_fp[j] << ";" << (float)area_fp[j] / (float)nver << std::endl;
-				}
-				rate_file.close();
-			}
-
-			myfile.close();
+		try {
+			evaluator.Verify(verification_dataset);
 		}
-		else {
+		catch (const std::exception&)
+		{
 			printf("Unable to open file %s", verification_dataset.c_str());
 			exit(0);
 		}
+
+		printf("\nVerification (non-elements):\n");
+		printf("True negatives: %lld\n", evaluator.GetReport().true_negatives);
+		printf("False positives: %lld\n", evaluator.GetReport().false_positives);
+		printf("False positives rate: %.5f\n", evaluator.GetReport().GetFpRate());
+
+		if (print_mode == 3 || print_mode == 4) evaluator.GetReport().SaveFpToDisk("fp" + buf + ".csv");
 	}
 
 	printf("Press any key to continue\n");